@@ -0,0 +1,326 @@
+#ifndef AGGREGATETABLE_HPP
+#define AGGREGATETABLE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <omp.h>
+
+// Reserved key marking an empty slot; group keys must never take this value
+constexpr uint64_t EMPTY_GROUP_KEY = ~0ULL;
+
+// Key ranges up to this size are aggregated in a dense array instead of a hash table
+constexpr uint64_t DENSE_KEY_LIMIT = 1 << 16;
+
+// A detected key range goes dense only if at least 1 in this many slots is used
+constexpr uint64_t DENSE_MIN_FILL = 4;
+
+// Number of radix partitions used when merging thread-local tables
+constexpr size_t MERGE_PARTITION_BITS = 6;
+constexpr size_t MERGE_PARTITIONS = size_t(1) << MERGE_PARTITION_BITS;
+
+// 64-bit finalizer (murmur3) so both low bits (probing) and high bits (partitioning) are well mixed
+inline uint64_t hashGroupKey(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+// Composite keys such as (PULocationID, DOLocationID) or (date, hour, vendor)
+inline uint64_t packGroupKey(uint32_t high, uint32_t low) {
+    return (static_cast<uint64_t>(high) << 32) | low;
+}
+
+inline size_t groupKeyPartition(uint64_t key) {
+    return hashGroupKey(key) >> (64 - MERGE_PARTITION_BITS);
+}
+
+// Open-addressing hash table (linear probing) from a 64-bit group key to an aggregate.
+// Keys and values live side by side so a probe usually touches a single cache line.
+// Value must be default constructible and provide merge(const Value&).
+template <typename Value>
+class AggregateTable {
+public:
+    struct Slot {
+        uint64_t key = EMPTY_GROUP_KEY;
+        Value value{};
+    };
+
+    explicit AggregateTable(size_t expectedGroups = 1024) {
+        size_t capacity = 16;
+        while (capacity * 7 < expectedGroups * 10) capacity <<= 1;
+        slots.resize(capacity);
+        mask = capacity - 1;
+    }
+
+    Value& operator[](uint64_t key) {
+        size_t pos = hashGroupKey(key) & mask;
+        while (true) {
+            Slot& slot = slots[pos];
+            if (slot.key == key) return slot.value;
+            if (slot.key == EMPTY_GROUP_KEY) {
+                // Keep load factor below 0.7 so probe sequences stay short
+                if (needsGrow()) {
+                    grow();
+                    return (*this)[key];
+                }
+                slot.key = key;
+                groupCount++;
+                return slot.value;
+            }
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    const Value* find(uint64_t key) const {
+        size_t pos = hashGroupKey(key) & mask;
+        while (true) {
+            const Slot& slot = slots[pos];
+            if (slot.key == key) return &slot.value;
+            if (slot.key == EMPTY_GROUP_KEY) return nullptr;
+            pos = (pos + 1) & mask;
+        }
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (const Slot& slot : slots) {
+            if (slot.key != EMPTY_GROUP_KEY) fn(slot.key, slot.value);
+        }
+    }
+
+    size_t size() const { return groupCount; }
+    size_t memoryUsage() const { return slots.size() * sizeof(Slot); }
+
+    // True when inserting one more group would double the slot array
+    bool needsGrow() const { return (groupCount + 1) * 10 > slots.size() * 7; }
+
+    void clear() {
+        std::vector<Slot>(16).swap(slots);
+        mask = 15;
+        groupCount = 0;
+    }
+
+private:
+    void grow() {
+        std::vector<Slot> old(slots.size() * 2);
+        old.swap(slots);
+        mask = slots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.key == EMPTY_GROUP_KEY) continue;
+            size_t pos = hashGroupKey(slot.key) & mask;
+            while (slots[pos].key != EMPTY_GROUP_KEY) pos = (pos + 1) & mask;
+            slots[pos] = slot;
+        }
+    }
+
+    std::vector<Slot> slots;
+    size_t mask = 0;
+    size_t groupCount = 0;
+};
+
+// Thread-local group-by state. Keys inside the dense window [denseBase,
+// denseBase + dense.size()) are aggregated in a flat array; any other key falls
+// back to the hash table, so out-of-range keys are never dropped.
+//
+// A keyRange fixes the window to [0, keyRange). Without one the window adapts to
+// the data: each time the hash table is about to grow, the key span seen so far
+// is checked, and if it is small (<= maxDense) and at least 1/DENSE_MIN_FILL
+// occupied, all groups move into a window over that span with room to extend.
+// This picks up packed dates and time buckets without the caller sizing them.
+template <typename Value>
+class GroupAggregator {
+public:
+    explicit GroupAggregator(uint64_t keyRange = 0, uint64_t maxDense = DENSE_KEY_LIMIT)
+        : sparse(0),
+          adaptive(keyRange == 0),
+          denseLimit(std::min(maxDense, DENSE_KEY_LIMIT)) {
+        if (keyRange && keyRange <= DENSE_KEY_LIMIT) {
+            dense.resize(keyRange);
+            present.resize(keyRange, 0);
+        }
+    }
+
+    Value& operator[](uint64_t key) {
+        // Keys below denseBase wrap around to huge indices and miss the window
+        const uint64_t index = key - denseBase;
+        if (index < dense.size()) {
+            present[index] = 1;
+            return dense[index];
+        }
+        if (adaptive && sparse.needsGrow() && sparse.size() != checkedSize) {
+            adaptDenseWindow();
+            return (*this)[key];
+        }
+        return sparse[key];
+    }
+
+    bool inDenseWindow(uint64_t key) const { return key - denseBase < dense.size(); }
+
+    const Value* find(uint64_t key) const {
+        const uint64_t index = key - denseBase;
+        if (index < dense.size()) return present[index] ? &dense[index] : nullptr;
+        return sparse.find(key);
+    }
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t i = 0; i < dense.size(); ++i) {
+            if (present[i]) fn(denseBase + i, dense[i]);
+        }
+        sparse.forEach(fn);
+    }
+
+    size_t memoryUsage() const {
+        return dense.size() * (sizeof(Value) + 1) + sparse.memoryUsage();
+    }
+
+    // Drops every group but keeps the dense window
+    void clear() {
+        std::fill(dense.begin(), dense.end(), Value{});
+        std::fill(present.begin(), present.end(), 0);
+        sparse.clear();
+        checkedSize = 0;
+    }
+
+    uint64_t denseBase = 0;
+    std::vector<Value> dense;
+    std::vector<uint8_t> present;
+    AggregateTable<Value> sparse;
+
+private:
+    void adaptDenseWindow() {
+        checkedSize = sparse.size();
+
+        uint64_t low = ~0ULL, high = 0;
+        size_t groups = 0;
+        forEach([&](uint64_t key, const Value&) {
+            low = std::min(low, key);
+            high = std::max(high, key);
+            groups++;
+        });
+        const uint64_t span = high - low + 1;
+        if (span > denseLimit || span > groups * DENSE_MIN_FILL) return;
+
+        // Twice the span leaves room for keys that keep extending the range
+        const uint64_t size = std::min<uint64_t>(denseLimit, std::max<uint64_t>(span * 2, dense.size()));
+        if (low >= denseBase && high - denseBase < dense.size()) return;
+
+        std::vector<std::pair<uint64_t, Value>> moved;
+        moved.reserve(groups);
+        forEach([&](uint64_t key, const Value& value) { moved.emplace_back(key, value); });
+
+        denseBase = low;
+        dense.assign(size, Value{});
+        present.assign(size, 0);
+        sparse.clear();
+        for (const auto& [key, value] : moved) {
+            if (inDenseWindow(key)) {
+                present[key - denseBase] = 1;
+                dense[key - denseBase] = value;
+            } else {
+                sparse[key] = value;
+            }
+        }
+        checkedSize = sparse.size();
+    }
+
+    bool adaptive;
+    uint64_t denseLimit;
+    size_t checkedSize = 0;
+};
+
+// Merges thread-local aggregators into a flat list of (key, value) groups.
+// The dense range is merged in parallel by index slices; hash-table groups are
+// scattered into radix partitions by each thread and every partition is then
+// merged independently, so no step runs serially over all groups.
+template <typename Value>
+std::vector<std::pair<uint64_t, Value>> mergeGroups(const std::vector<GroupAggregator<Value>>& locals) {
+    std::vector<std::pair<uint64_t, Value>> result;
+    if (locals.empty()) return result;
+
+    const int numLocals = static_cast<int>(locals.size());
+
+    // Fixed key ranges give every thread the same window, merged by index below.
+    // Adapted windows differ per thread, so their groups go through the partitions.
+    bool sharedWindow = true;
+    for (const auto& local : locals) {
+        sharedWindow = sharedWindow && local.denseBase == locals[0].denseBase &&
+                       local.dense.size() == locals[0].dense.size();
+    }
+    const uint64_t denseBase = locals[0].denseBase;
+    const int64_t denseSize = sharedWindow ? static_cast<int64_t>(locals[0].dense.size()) : 0;
+
+    // Dense keys: each index is owned by exactly one merging thread
+    std::vector<Value> denseMerged(denseSize);
+    std::vector<uint8_t> densePresent(denseSize, 0);
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < denseSize; ++i) {
+        for (const auto& local : locals) {
+            if (local.present[i]) {
+                denseMerged[i].merge(local.dense[i]);
+                densePresent[i] = 1;
+            }
+        }
+    }
+
+    // Sparse keys, phase 1: scatter every local table into radix partitions
+    std::vector<std::vector<std::vector<std::pair<uint64_t, Value>>>> runs(
+        numLocals, std::vector<std::vector<std::pair<uint64_t, Value>>>(MERGE_PARTITIONS));
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < numLocals; ++t) {
+        auto& localRuns = runs[t];
+        auto scatter = [&](uint64_t key, const Value& value) {
+            localRuns[groupKeyPartition(key)].emplace_back(key, value);
+        };
+        if (sharedWindow) {
+            locals[t].sparse.forEach(scatter);
+        } else {
+            locals[t].forEach(scatter);
+        }
+    }
+
+    // Phase 2: merge each partition on its own thread
+    std::vector<std::vector<std::pair<uint64_t, Value>>> partitions(MERGE_PARTITIONS + 1);
+    #pragma omp parallel for schedule(dynamic)
+    for (int p = 0; p < static_cast<int>(MERGE_PARTITIONS); ++p) {
+        size_t expected = 0;
+        for (int t = 0; t < numLocals; ++t) expected += runs[t][p].size();
+        if (expected == 0) continue;
+
+        AggregateTable<Value> table(expected);
+        for (int t = 0; t < numLocals; ++t) {
+            for (const auto& [key, value] : runs[t][p]) {
+                table[key].merge(value);
+            }
+            std::vector<std::pair<uint64_t, Value>>().swap(runs[t][p]);
+        }
+        partitions[p].reserve(table.size());
+        table.forEach([&](uint64_t key, const Value& value) {
+            partitions[p].emplace_back(key, value);
+        });
+    }
+
+    for (int64_t i = 0; i < denseSize; ++i) {
+        if (densePresent[i]) partitions[MERGE_PARTITIONS].emplace_back(denseBase + i, denseMerged[i]);
+    }
+
+    // Concatenate partitions in parallel using prefix-summed offsets
+    std::vector<size_t> offsets(partitions.size() + 1, 0);
+    for (size_t p = 0; p < partitions.size(); ++p) {
+        offsets[p + 1] = offsets[p] + partitions[p].size();
+    }
+    result.resize(offsets.back());
+    #pragma omp parallel for schedule(dynamic)
+    for (int p = 0; p < static_cast<int>(partitions.size()); ++p) {
+        std::copy(partitions[p].begin(), partitions[p].end(), result.begin() + offsets[p]);
+    }
+    return result;
+}
+
+#endif
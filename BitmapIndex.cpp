@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <omp.h>
+#include "BitmapIndex.hpp"
+#include "Serialization.hpp"
+
+namespace {
+
+constexpr char INDEX_MAGIC[4] = {'T', 'I', 'D', 'X'};
+constexpr uint32_t INDEX_VERSION = 2;
+
+using Container = RoaringBitmap::Container;
+
+uint32_t popcountWords(const std::vector<uint64_t>& words) {
+    uint32_t count = 0;
+    for (uint64_t w : words) count += static_cast<uint32_t>(_mm_popcnt_u64(w));
+    return count;
+}
+
+// Dense containers that shrink to ARRAY_LIMIT entries go back to array form
+void compact(Container& container) {
+    if (!container.isBitmap() || container.cardinality > RoaringBitmap::ARRAY_LIMIT) return;
+    std::vector<uint16_t> array;
+    array.reserve(container.cardinality);
+    for (size_t w = 0; w < RoaringBitmap::BITMAP_WORDS; ++w) {
+        uint64_t bits = container.bitmap[w];
+        while (bits) {
+            array.push_back(static_cast<uint16_t>(w * 64 + _tzcnt_u64(bits)));
+            bits &= bits - 1;
+        }
+    }
+    container.array = std::move(array);
+    container.bitmap.clear();
+}
+
+Container intersectContainers(const Container& a, const Container& b) {
+    Container result;
+    if (a.isBitmap() && b.isBitmap()) {
+        result.bitmap.resize(RoaringBitmap::BITMAP_WORDS);
+        for (size_t w = 0; w < RoaringBitmap::BITMAP_WORDS; ++w) {
+            result.bitmap[w] = a.bitmap[w] & b.bitmap[w];
+        }
+        result.cardinality = popcountWords(result.bitmap);
+        compact(result);
+    } else if (a.isBitmap() || b.isBitmap()) {
+        const Container& dense = a.isBitmap() ? a : b;
+        const Container& sparse = a.isBitmap() ? b : a;
+        for (uint16_t low : sparse.array) {
+            if (dense.bitmap[low >> 6] & (1ULL << (low & 63))) result.array.push_back(low);
+        }
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+    } else {
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                              std::back_inserter(result.array));
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+    }
+    return result;
+}
+
+Container uniteContainers(const Container& a, const Container& b) {
+    Container result;
+    if (!a.isBitmap() && !b.isBitmap()) {
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                       std::back_inserter(result.array));
+        result.cardinality = static_cast<uint32_t>(result.array.size());
+        if (result.cardinality > RoaringBitmap::ARRAY_LIMIT) result.toBitmap();
+        return result;
+    }
+
+    result.bitmap.assign(RoaringBitmap::BITMAP_WORDS, 0);
+    for (const Container* c : {&a, &b}) {
+        if (c->isBitmap()) {
+            for (size_t w = 0; w < RoaringBitmap::BITMAP_WORDS; ++w) result.bitmap[w] |= c->bitmap[w];
+        } else {
+            for (uint16_t low : c->array) result.bitmap[low >> 6] |= 1ULL << (low & 63);
+        }
+    }
+    result.cardinality = popcountWords(result.bitmap);
+    return result;
+}
+
+void writeBitmap(std::ofstream& out, const RoaringBitmap& bitmap) {
+    writeVector(out, bitmap.keys);
+    for (const Container& container : bitmap.containers) {
+        writePod(out, container.cardinality);
+        writeVector(out, container.array);
+        writeVector(out, container.bitmap);
+    }
+}
+
+void readBitmap(std::ifstream& in, RoaringBitmap& bitmap) {
+    readVector(in, bitmap.keys);
+    bitmap.containers.resize(bitmap.keys.size());
+    for (Container& container : bitmap.containers) {
+        readPod(in, container.cardinality);
+        readVector(in, container.array);
+        readVector(in, container.bitmap);
+    }
+}
+
+void writeIndex(std::ofstream& out, const ValueIndex& index) {
+    writeVector(out, index.values);
+    for (const RoaringBitmap& bitmap : index.bitmaps) writeBitmap(out, bitmap);
+}
+
+void readIndex(std::ifstream& in, ValueIndex& index) {
+    readVector(in, index.values);
+    index.bitmaps.resize(index.values.size());
+    for (RoaringBitmap& bitmap : index.bitmaps) readBitmap(in, bitmap);
+}
+
+// One bitmap per dictionary code, appended in row order
+ValueIndex indexDictionary(const DictionaryColumn& column, size_t rowCount) {
+    ValueIndex index;
+    index.values = column.dictionary;
+    index.bitmaps.resize(column.dictionary.size());
+    for (size_t row = 0; row < rowCount; ++row) {
+        index.bitmaps[column.codes.get(row)].append(static_cast<uint32_t>(row));
+    }
+    return index;
+}
+
+// One bitmap per distinct run value
+ValueIndex indexRuns(const RunLengthColumn& column) {
+    ValueIndex index;
+    for (uint32_t value : column.values) index.values.push_back(static_cast<int32_t>(value));
+    std::sort(index.values.begin(), index.values.end());
+    index.values.erase(std::unique(index.values.begin(), index.values.end()), index.values.end());
+    index.bitmaps.resize(index.values.size());
+
+    column.forEachRun([&](uint32_t begin, uint32_t end, uint32_t value) {
+        auto it = std::lower_bound(index.values.begin(), index.values.end(), static_cast<int32_t>(value));
+        RoaringBitmap& bitmap = index.bitmaps[it - index.values.begin()];
+        for (uint32_t row = begin; row < end; ++row) {
+            bitmap.append(row);
+        }
+    });
+    return index;
+}
+
+size_t indexMemory(const ValueIndex& index) {
+    size_t bytes = index.values.size() * sizeof(int32_t);
+    for (const RoaringBitmap& bitmap : index.bitmaps) bytes += bitmap.memoryUsage();
+    return bytes;
+}
+
+} // namespace
+
+void RoaringBitmap::Container::add(uint16_t low) {
+    if (isBitmap()) {
+        uint64_t& word = bitmap[low >> 6];
+        const uint64_t bit = 1ULL << (low & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            cardinality++;
+        }
+        return;
+    }
+    if (!array.empty() && array.back() == low) return;
+    array.push_back(low);
+    cardinality++;
+    if (cardinality > ARRAY_LIMIT) toBitmap();
+}
+
+void RoaringBitmap::Container::toBitmap() {
+    bitmap.assign(BITMAP_WORDS, 0);
+    for (uint16_t low : array) bitmap[low >> 6] |= 1ULL << (low & 63);
+    std::vector<uint16_t>().swap(array);
+}
+
+void RoaringBitmap::append(uint32_t row) {
+    const uint16_t high = static_cast<uint16_t>(row >> 16);
+    if (keys.empty() || keys.back() != high) {
+        keys.push_back(high);
+        containers.emplace_back();
+    }
+    containers.back().add(static_cast<uint16_t>(row & 0xFFFF));
+}
+
+size_t RoaringBitmap::cardinality() const {
+    size_t count = 0;
+    for (const Container& container : containers) count += container.cardinality;
+    return count;
+}
+
+size_t RoaringBitmap::memoryUsage() const {
+    size_t bytes = keys.size() * sizeof(uint16_t);
+    for (const Container& container : containers) {
+        bytes += container.array.size() * sizeof(uint16_t) + container.bitmap.size() * sizeof(uint64_t);
+    }
+    return bytes;
+}
+
+RoaringBitmap RoaringBitmap::intersect(const RoaringBitmap& a, const RoaringBitmap& b) {
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < a.keys.size() && j < b.keys.size()) {
+        if (a.keys[i] < b.keys[j]) {
+            i++;
+        } else if (a.keys[i] > b.keys[j]) {
+            j++;
+        } else {
+            Container container = intersectContainers(a.containers[i], b.containers[j]);
+            if (container.cardinality > 0) {
+                result.keys.push_back(a.keys[i]);
+                result.containers.push_back(std::move(container));
+            }
+            i++;
+            j++;
+        }
+    }
+    return result;
+}
+
+RoaringBitmap RoaringBitmap::unite(const RoaringBitmap& a, const RoaringBitmap& b) {
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < a.keys.size() || j < b.keys.size()) {
+        if (j == b.keys.size() || (i < a.keys.size() && a.keys[i] < b.keys[j])) {
+            result.keys.push_back(a.keys[i]);
+            result.containers.push_back(a.containers[i++]);
+        } else if (i == a.keys.size() || b.keys[j] < a.keys[i]) {
+            result.keys.push_back(b.keys[j]);
+            result.containers.push_back(b.containers[j++]);
+        } else {
+            result.keys.push_back(a.keys[i]);
+            result.containers.push_back(uniteContainers(a.containers[i++], b.containers[j++]));
+        }
+    }
+    return result;
+}
+
+const RoaringBitmap& ValueIndex::find(int32_t value) const {
+    static const RoaringBitmap empty;
+    auto it = std::lower_bound(values.begin(), values.end(), value);
+    return (it != values.end() && *it == value) ? bitmaps[it - values.begin()] : empty;
+}
+
+RoaringBitmap ValueIndex::range(int32_t low, int32_t high) const {
+    RoaringBitmap result;
+    auto first = std::lower_bound(values.begin(), values.end(), low);
+    auto last = std::upper_bound(values.begin(), values.end(), high);
+    for (auto it = first; it != last; ++it) {
+        result = RoaringBitmap::unite(result, bitmaps[it - values.begin()]);
+    }
+    return result;
+}
+
+BitmapIndex BitmapIndex::build(const ColumnStore& store) {
+    BitmapIndex index;
+    index.rowCount = store.rowCount;
+
+    // Columns are independent, so each is indexed on its own thread
+    #pragma omp parallel sections
+    {
+        #pragma omp section
+        index.vendor = indexDictionary(store.vendor, store.rowCount);
+        #pragma omp section
+        index.payment = indexDictionary(store.payment, store.rowCount);
+        #pragma omp section
+        index.flag = indexDictionary(store.flag, store.rowCount);
+        #pragma omp section
+        index.day = indexRuns(store.date);
+    }
+    return index;
+}
+
+void BitmapIndex::save(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Error creating index file: " + filename);
+    }
+
+    out.write(INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    writePod(out, INDEX_VERSION);
+    writePod(out, static_cast<uint64_t>(rowCount));
+    writeIndex(out, vendor);
+    writeIndex(out, payment);
+    writeIndex(out, flag);
+    writeIndex(out, day);
+
+    if (!out) {
+        throw std::runtime_error("Error writing index file: " + filename);
+    }
+}
+
+BitmapIndex BitmapIndex::load(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Error opening index file: " + filename);
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    in.read(magic, sizeof(magic));
+    readPod(in, version);
+    if (!in || !std::equal(magic, magic + 4, INDEX_MAGIC) || version != INDEX_VERSION) {
+        throw std::runtime_error("Not a supported index file: " + filename);
+    }
+
+    BitmapIndex index;
+    uint64_t rows = 0;
+    readPod(in, rows);
+    index.rowCount = rows;
+    readIndex(in, index.vendor);
+    readIndex(in, index.payment);
+    readIndex(in, index.flag);
+    readIndex(in, index.day);
+
+    if (!in) {
+        throw std::runtime_error("Truncated index file: " + filename);
+    }
+    return index;
+}
+
+size_t BitmapIndex::memoryUsage() const {
+    return indexMemory(vendor) + indexMemory(payment) + indexMemory(flag) + indexMemory(day);
+}
@@ -0,0 +1,90 @@
+#ifndef BITMAPINDEX_HPP
+#define BITMAPINDEX_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <immintrin.h>
+#include "ColumnStore.hpp"
+
+// Compressed row-id bitmap in the Roaring layout: row ids are split by their high
+// 16 bits into containers, each holding the low 16 bits either as a sorted array
+// (sparse, up to 4096 entries) or as a 65536-bit bitmap (dense).
+class RoaringBitmap {
+public:
+    static constexpr size_t ARRAY_LIMIT = 4096;
+    static constexpr size_t BITMAP_WORDS = 65536 / 64;
+
+    struct Container {
+        std::vector<uint16_t> array;
+        std::vector<uint64_t> bitmap;  // empty unless dense
+        uint32_t cardinality = 0;
+
+        bool isBitmap() const { return !bitmap.empty(); }
+        void add(uint16_t low);
+        void toBitmap();
+    };
+
+    // Row ids must be appended in increasing order (as they are during ingest)
+    void append(uint32_t row);
+
+    size_t cardinality() const;
+    size_t memoryUsage() const;
+
+    static RoaringBitmap intersect(const RoaringBitmap& a, const RoaringBitmap& b);
+    static RoaringBitmap unite(const RoaringBitmap& a, const RoaringBitmap& b);
+
+    template <typename Fn>
+    void forEach(Fn&& fn) const {
+        for (size_t c = 0; c < keys.size(); ++c) {
+            const uint32_t high = static_cast<uint32_t>(keys[c]) << 16;
+            const Container& container = containers[c];
+            if (container.isBitmap()) {
+                for (size_t w = 0; w < BITMAP_WORDS; ++w) {
+                    uint64_t bits = container.bitmap[w];
+                    while (bits) {
+                        fn(high | static_cast<uint32_t>(w * 64 + _tzcnt_u64(bits)));
+                        bits &= bits - 1;
+                    }
+                }
+            } else {
+                for (uint16_t low : container.array) fn(high | low);
+            }
+        }
+    }
+
+    std::vector<uint16_t> keys;
+    std::vector<Container> containers;
+};
+
+// Per-value bitmaps for one low-cardinality column
+struct ValueIndex {
+    std::vector<int32_t> values;
+    std::vector<RoaringBitmap> bitmaps;
+
+    // Bitmap for a value; an empty bitmap if the value never occurs
+    const RoaringBitmap& find(int32_t value) const;
+
+    // Union of the bitmaps of all values in [low, high]
+    RoaringBitmap range(int32_t low, int32_t high) const;
+};
+
+// Bitmap indexes built at ingest time alongside the column store
+class BitmapIndex {
+public:
+    static BitmapIndex build(const ColumnStore& store);
+
+    void save(const std::string& filename) const;
+    static BitmapIndex load(const std::string& filename);
+
+    size_t memoryUsage() const;
+
+    size_t rowCount = 0;  // rows of the column store the index was built from
+    ValueIndex vendor;
+    ValueIndex payment;
+    ValueIndex flag;
+    ValueIndex day;  // YYYYMMDD keys
+};
+
+#endif
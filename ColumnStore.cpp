@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <immintrin.h>
+#include <omp.h>
+#include "ColumnStore.hpp"
+#include "Serialization.hpp"
+
+namespace {
+
+constexpr char STORE_MAGIC[4] = {'T', 'C', 'O', 'L'};
+constexpr uint32_t STORE_VERSION = 2;
+
+// Clears rows [begin, end) in a selection
+void clearRows(Selection& selection, size_t begin, size_t end) {
+    while (begin < end && (begin & 63)) {
+        selection[begin >> 6] &= ~(1ULL << (begin & 63));
+        begin++;
+    }
+    for (; begin + 64 <= end; begin += 64) {
+        selection[begin >> 6] = 0;
+    }
+    for (; begin < end; begin++) {
+        selection[begin >> 6] &= ~(1ULL << (begin & 63));
+    }
+}
+
+// Reads a vector, or seeks past its data when the column is not loaded
+template <typename T>
+void readOrSkipVector(std::ifstream& in, std::vector<T>& values, bool keep) {
+    if (keep) {
+        readVector(in, values);
+        return;
+    }
+    uint64_t size = 0;
+    readPod(in, size);
+    if (in) in.seekg(static_cast<std::streamoff>(size * sizeof(T)), std::ios::cur);
+}
+
+void writeColumn(std::ofstream& out, const BitPackedColumn& column) {
+    writePod(out, column.width);
+    writePod(out, static_cast<uint64_t>(column.length));
+    writeVector(out, column.bytes);
+}
+
+void readColumn(std::ifstream& in, BitPackedColumn& column, bool keep = true) {
+    uint64_t length = 0;
+    readPod(in, column.width);
+    readPod(in, length);
+    column.length = length;
+    readOrSkipVector(in, column.bytes, keep);
+}
+
+void writeColumn(std::ofstream& out, const DictionaryColumn& column) {
+    writeVector(out, column.dictionary);
+    writeColumn(out, column.codes);
+}
+
+void readColumn(std::ifstream& in, DictionaryColumn& column, bool keep = true) {
+    readOrSkipVector(in, column.dictionary, keep);
+    readColumn(in, column.codes, keep);
+}
+
+void writeColumn(std::ofstream& out, const RunLengthColumn& column) {
+    writeVector(out, column.values);
+    writeVector(out, column.runEnds);
+    writePod(out, column.codeWidth);
+    writeVector(out, column.codes);
+}
+
+void readColumn(std::ifstream& in, RunLengthColumn& column, bool keep = true) {
+    readOrSkipVector(in, column.values, keep);
+    readOrSkipVector(in, column.runEnds, keep);
+    readPod(in, column.codeWidth);
+    readOrSkipVector(in, column.codes, keep);
+}
+
+void writeColumn(std::ofstream& out, const FrameOfReferenceColumn& column) {
+    writePod(out, column.base);
+    writePod(out, column.width);
+    writePod(out, static_cast<uint64_t>(column.length));
+    writeVector(out, column.bytes);
+}
+
+void readColumn(std::ifstream& in, FrameOfReferenceColumn& column, bool keep = true) {
+    uint64_t length = 0;
+    readPod(in, column.base);
+    readPod(in, column.width);
+    readPod(in, length);
+    column.length = length;
+    readOrSkipVector(in, column.bytes, keep);
+}
+
+} // namespace
+
+BitPackedColumn BitPackedColumn::pack(const std::vector<uint32_t>& codes) {
+    BitPackedColumn column;
+    column.length = codes.size();
+
+    const uint32_t maxCode = codes.empty() ? 0 : *std::max_element(codes.begin(), codes.end());
+    if (maxCode > 255) {
+        throw std::runtime_error("Code too wide for bit packing");
+    }
+    column.width = maxCode < 2 ? 1 : maxCode < 4 ? 2 : maxCode < 16 ? 4 : 8;
+
+    const size_t perByte = 8 / column.width;
+    const size_t numBytes = (codes.size() + perByte - 1) / perByte;
+    column.bytes.assign((numBytes + 31) / 32 * 32, 0);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t b = 0; b < static_cast<int64_t>(numBytes); ++b) {
+        uint8_t packed = 0;
+        for (size_t j = 0; j < perByte; ++j) {
+            const size_t row = b * perByte + j;
+            if (row < codes.size()) packed |= static_cast<uint8_t>(codes[row] << (j * column.width));
+        }
+        column.bytes[b] = packed;
+    }
+    return column;
+}
+
+void BitPackedColumn::filterEqual(uint32_t code, Selection& selection) const {
+    // Codes per byte and the bit pattern where sub-code 0 of each byte lands in a
+    // 32-bit result word (e.g. every other bit for 4-bit codes)
+    const unsigned perByte = 8 / width;
+    const unsigned bytesPerWord = 32 / perByte;
+    const uint32_t segmentMask = bytesPerWord == 32 ? ~0u : (1u << bytesPerWord) - 1;
+    const uint32_t lanePattern = perByte == 1 ? ~0u : perByte == 2 ? 0x55555555u
+                               : perByte == 4 ? 0x11111111u : 0x01010101u;
+
+    const __m256i valueMask = _mm256_set1_epi8(static_cast<char>((1u << width) - 1));
+    const __m256i target = _mm256_set1_epi8(static_cast<char>(code));
+
+    uint32_t* out = reinterpret_cast<uint32_t*>(selection.data());
+    const size_t outWords = selection.size() * 2;
+    const size_t numVectors = bytes.size() / 32;
+
+    for (size_t v = 0; v < numVectors; ++v) {
+        const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(bytes.data() + v * 32));
+
+        // One 32-bit match mask per sub-code position within the bytes
+        uint32_t masks[8];
+        for (unsigned j = 0; j < perByte; ++j) {
+            __m256i codes = _mm256_and_si256(_mm256_srl_epi16(chunk, _mm_cvtsi32_si128(j * width)), valueMask);
+            masks[j] = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(codes, target)));
+        }
+
+        // Interleave the masks back into row order
+        for (unsigned q = 0; q < perByte; ++q) {
+            const size_t word = v * perByte + q;
+            if (word >= outWords) return;
+
+            uint32_t bits = 0;
+            for (unsigned j = 0; j < perByte; ++j) {
+                const uint32_t segment = (masks[j] >> (q * bytesPerWord)) & segmentMask;
+                bits |= _pdep_u32(segment, lanePattern << j);
+            }
+            out[word] &= bits;
+        }
+    }
+}
+
+DictionaryColumn DictionaryColumn::encode(const std::vector<int32_t>& values) {
+    DictionaryColumn column;
+    column.dictionary = values;
+    std::sort(column.dictionary.begin(), column.dictionary.end());
+    column.dictionary.erase(std::unique(column.dictionary.begin(), column.dictionary.end()),
+                            column.dictionary.end());
+    if (column.dictionary.size() > 256) {
+        throw std::runtime_error("Too many distinct values for dictionary encoding");
+    }
+
+    std::vector<uint32_t> codes(values.size());
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < static_cast<int64_t>(values.size()); ++i) {
+        codes[i] = static_cast<uint32_t>(std::lower_bound(column.dictionary.begin(),
+            column.dictionary.end(), values[i]) - column.dictionary.begin());
+    }
+    column.codes = BitPackedColumn::pack(codes);
+    return column;
+}
+
+int32_t DictionaryColumn::codeOf(int32_t value) const {
+    auto it = std::lower_bound(dictionary.begin(), dictionary.end(), value);
+    return (it != dictionary.end() && *it == value) ? static_cast<int32_t>(it - dictionary.begin()) : -1;
+}
+
+void DictionaryColumn::filterEqual(int32_t value, Selection& selection) const {
+    const int32_t code = codeOf(value);
+    if (code < 0) {
+        std::fill(selection.begin(), selection.end(), 0);
+        return;
+    }
+    codes.filterEqual(static_cast<uint32_t>(code), selection);
+}
+
+RunLengthColumn RunLengthColumn::encode(const std::vector<uint32_t>& values) {
+    if (values.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Too many rows for run-length encoding");
+    }
+
+    RunLengthColumn column;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (column.values.empty() || column.values.back() != values[i]) {
+            column.values.push_back(values[i]);
+            column.runEnds.push_back(static_cast<uint32_t>(i + 1));
+        } else {
+            column.runEnds.back() = static_cast<uint32_t>(i + 1);
+        }
+    }
+
+    // Unclustered data: switch to per-row codes if they are smaller than the runs
+    std::vector<uint32_t> distinct = column.values;
+    std::sort(distinct.begin(), distinct.end());
+    distinct.erase(std::unique(distinct.begin(), distinct.end()), distinct.end());
+    if (distinct.size() > 0x10000) return column;
+    const uint8_t width = distinct.size() <= 0x100 ? 8 : 16;
+    const size_t codedBytes = distinct.size() * sizeof(uint32_t) + values.size() * (width / 8);
+    if (codedBytes >= column.memoryUsage()) return column;
+
+    RunLengthColumn coded;
+    coded.values = std::move(distinct);
+    coded.codeWidth = width;
+    coded.codes.assign(values.size() * (width / 8), 0);
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < static_cast<int64_t>(values.size()); ++i) {
+        const auto code = std::lower_bound(coded.values.begin(), coded.values.end(), values[i]) - coded.values.begin();
+        if (width == 8) {
+            coded.codes[i] = static_cast<uint8_t>(code);
+        } else {
+            reinterpret_cast<uint16_t*>(coded.codes.data())[i] = static_cast<uint16_t>(code);
+        }
+    }
+    return coded;
+}
+
+uint32_t RunLengthColumn::get(size_t row) const {
+    if (!isRunLength()) return values[code(row)];
+    auto it = std::upper_bound(runEnds.begin(), runEnds.end(), static_cast<uint32_t>(row));
+    return values[it - runEnds.begin()];
+}
+
+void RunLengthColumn::filterRange(uint32_t low, uint32_t high, Selection& selection) const {
+    if (isRunLength()) {
+        forEachRun([&](uint32_t begin, uint32_t end, uint32_t value) {
+            if (value < low || value > high) clearRows(selection, begin, end);
+        });
+        return;
+    }
+
+    // Sorted values: the range is codes [first, last)
+    const uint32_t first = std::lower_bound(values.begin(), values.end(), low) - values.begin();
+    const uint32_t last = std::max<uint32_t>(first, std::upper_bound(values.begin(), values.end(), high) - values.begin());
+    const int64_t rows = static_cast<int64_t>(codes.size() / (codeWidth / 8));
+    #pragma omp parallel for schedule(static)
+    for (int64_t w = 0; w < static_cast<int64_t>(selection.size()); ++w) {
+        uint64_t keep = 0;
+        const int64_t end = std::min<int64_t>(rows, w * 64 + 64);
+        for (int64_t row = w * 64; row < end; ++row) {
+            keep |= static_cast<uint64_t>(code(row) - first < last - first) << (row - w * 64);
+        }
+        selection[w] &= keep;
+    }
+}
+
+FrameOfReferenceColumn FrameOfReferenceColumn::encode(const std::vector<double>& values) {
+    FrameOfReferenceColumn column;
+    column.length = values.size();
+
+    std::vector<int64_t> scaled(values.size());
+    int64_t minValue = std::numeric_limits<int64_t>::max();
+    int64_t maxValue = std::numeric_limits<int64_t>::min();
+    #pragma omp parallel for schedule(static) reduction(min:minValue) reduction(max:maxValue)
+    for (int64_t i = 0; i < static_cast<int64_t>(values.size()); ++i) {
+        scaled[i] = std::llround(values[i] * SCALE);
+        minValue = std::min(minValue, scaled[i]);
+        maxValue = std::max(maxValue, scaled[i]);
+    }
+    if (values.empty()) minValue = maxValue = 0;
+
+    const uint64_t range = static_cast<uint64_t>(maxValue - minValue);
+    if (range > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Value range too wide for frame-of-reference encoding");
+    }
+    column.base = minValue;
+    column.width = range <= 0xFF ? 8 : range <= 0xFFFF ? 16 : 32;
+    column.bytes.assign(values.size() * (column.width / 8), 0);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < static_cast<int64_t>(values.size()); ++i) {
+        const uint64_t offset = static_cast<uint64_t>(scaled[i] - minValue);
+        switch (column.width) {
+            case 8: column.bytes[i] = static_cast<uint8_t>(offset); break;
+            case 16: reinterpret_cast<uint16_t*>(column.bytes.data())[i] = static_cast<uint16_t>(offset); break;
+            default: reinterpret_cast<uint32_t*>(column.bytes.data())[i] = static_cast<uint32_t>(offset); break;
+        }
+    }
+    return column;
+}
+
+double FrameOfReferenceColumn::sumSelected(const Selection& selection) const {
+    int64_t offsetSum = 0;
+    int64_t count = 0;
+
+    #pragma omp parallel for schedule(static) reduction(+:offsetSum, count)
+    for (int64_t w = 0; w < static_cast<int64_t>(selection.size()); ++w) {
+        uint64_t bits = selection[w];
+        if (bits == ~0ULL) {
+            // Fully selected word: contiguous loop the compiler can vectorize
+            for (size_t i = w * 64; i < static_cast<size_t>(w * 64 + 64); ++i) offsetSum += offset(i);
+            count += 64;
+            continue;
+        }
+        while (bits) {
+            offsetSum += offset(w * 64 + _tzcnt_u64(bits));
+            count++;
+            bits &= bits - 1;
+        }
+    }
+    return (offsetSum + count * base) / SCALE;
+}
+
+ColumnStore ColumnStore::build(const TripRecord* records, size_t count) {
+    std::vector<int32_t> vendors(count), payments(count), flags(count), passengerCounts(count);
+    std::vector<uint32_t> dates(count);
+    std::vector<double> fares(count), tips(count), distances(count);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < static_cast<int64_t>(count); ++i) {
+        const TripRecord& record = records[i];
+        vendors[i] = record.VendorID;
+        payments[i] = record.Payment_type;
+        flags[i] = record.Store_and_fwd_flag;
+        passengerCounts[i] = record.passenger_count;
+        dates[i] = record.getDateKey();
+        fares[i] = record.fare;
+        tips[i] = record.tip;
+        distances[i] = record.Trip_distance;
+    }
+
+    ColumnStore store;
+    store.rowCount = count;
+    store.vendor = DictionaryColumn::encode(vendors);
+    store.payment = DictionaryColumn::encode(payments);
+    store.flag = DictionaryColumn::encode(flags);
+    store.passengers = DictionaryColumn::encode(passengerCounts);
+    store.date = RunLengthColumn::encode(dates);
+    store.fare = FrameOfReferenceColumn::encode(fares);
+    store.tip = FrameOfReferenceColumn::encode(tips);
+    store.distance = FrameOfReferenceColumn::encode(distances);
+    return store;
+}
+
+void ColumnStore::save(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Error creating column file: " + filename);
+    }
+
+    out.write(STORE_MAGIC, sizeof(STORE_MAGIC));
+    writePod(out, STORE_VERSION);
+    writePod(out, static_cast<uint64_t>(rowCount));
+    writeColumn(out, vendor);
+    writeColumn(out, payment);
+    writeColumn(out, flag);
+    writeColumn(out, passengers);
+    writeColumn(out, date);
+    writeColumn(out, fare);
+    writeColumn(out, tip);
+    writeColumn(out, distance);
+
+    if (!out) {
+        throw std::runtime_error("Error writing column file: " + filename);
+    }
+}
+
+ColumnStore ColumnStore::load(const std::string& filename, uint32_t columns) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Error opening column file: " + filename);
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    in.read(magic, sizeof(magic));
+    readPod(in, version);
+    if (!in || !std::equal(magic, magic + 4, STORE_MAGIC) || version != STORE_VERSION) {
+        throw std::runtime_error("Not a supported column file: " + filename);
+    }
+
+    ColumnStore store;
+    uint64_t rows = 0;
+    readPod(in, rows);
+    store.rowCount = rows;
+    readColumn(in, store.vendor, columns & VENDOR_COLUMN);
+    readColumn(in, store.payment, columns & PAYMENT_COLUMN);
+    readColumn(in, store.flag, columns & FLAG_COLUMN);
+    readColumn(in, store.passengers, columns & PASSENGERS_COLUMN);
+    readColumn(in, store.date, columns & DATE_COLUMN);
+    readColumn(in, store.fare, columns & FARE_COLUMN);
+    readColumn(in, store.tip, columns & TIP_COLUMN);
+    readColumn(in, store.distance, columns & DISTANCE_COLUMN);
+
+    // Seeking past the end of a short file does not fail the stream
+    if (!in || static_cast<uint64_t>(in.tellg()) > std::filesystem::file_size(filename)) {
+        throw std::runtime_error("Truncated column file: " + filename);
+    }
+    return store;
+}
+
+Selection ColumnStore::selectAll() const {
+    Selection selection((rowCount + 63) / 64, ~0ULL);
+    if (rowCount % 64) {
+        selection.back() = (1ULL << (rowCount % 64)) - 1;
+    }
+    return selection;
+}
+
+size_t ColumnStore::countSelected(const Selection& selection) {
+    size_t count = 0;
+    for (uint64_t bits : selection) count += _mm_popcnt_u64(bits);
+    return count;
+}
+
+size_t ColumnStore::memoryUsage() const {
+    return vendor.memoryUsage() + payment.memoryUsage() + flag.memoryUsage() + passengers.memoryUsage()
+         + date.memoryUsage() + fare.memoryUsage() + tip.memoryUsage() + distance.memoryUsage();
+}
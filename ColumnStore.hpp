@@ -0,0 +1,162 @@
+#ifndef COLUMNSTORE_HPP
+#define COLUMNSTORE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "TripRecord.hpp"
+
+// Row selections are bitmaps: bit i of word i / 64 is set when row i qualifies.
+// Filters AND their matches into an existing selection so predicates compose.
+using Selection = std::vector<uint64_t>;
+
+// Unsigned codes packed at 1, 2, 4 or 8 bits so a code never straddles a byte.
+// Equality filters compare 32 bytes (32 to 256 codes) per AVX2 instruction.
+struct BitPackedColumn {
+    uint8_t width = 8;
+    size_t length = 0;
+    std::vector<uint8_t> bytes;  // padded to a multiple of 32
+
+    static BitPackedColumn pack(const std::vector<uint32_t>& codes);
+
+    uint32_t get(size_t row) const {
+        const size_t perByte = 8 / width;
+        return (bytes[row / perByte] >> ((row % perByte) * width)) & ((1u << width) - 1);
+    }
+
+    void filterEqual(uint32_t code, Selection& selection) const;
+    size_t memoryUsage() const { return bytes.size(); }
+};
+
+// Dictionary encoding for low-cardinality columns (VendorID, Payment_type, flag,
+// passenger_count): distinct values in a small table, rows as bit-packed codes
+struct DictionaryColumn {
+    std::vector<int32_t> dictionary;
+    BitPackedColumn codes;
+
+    static DictionaryColumn encode(const std::vector<int32_t>& values);
+
+    int32_t get(size_t row) const { return dictionary[codes.get(row)]; }
+
+    // Code for a value, or -1 if the value never occurs
+    int32_t codeOf(int32_t value) const;
+
+    // Rows equal to value; an absent value clears the selection
+    void filterEqual(int32_t value, Selection& selection) const;
+
+    size_t memoryUsage() const { return dictionary.size() * sizeof(int32_t) + codes.memoryUsage(); }
+};
+
+// Run-length encoding for sorted or clustered columns such as the pickup date
+// (stored as YYYYMMDD keys). Range filters touch runs, not rows. When the data
+// is not clustered and runs would take more space than one code per row, the
+// column instead keeps its distinct values sorted and an 8- or 16-bit code per
+// row, so a value range is a contiguous code range.
+struct RunLengthColumn {
+    std::vector<uint32_t> values;   // value of each run, or the sorted distinct values
+    std::vector<uint32_t> runEnds;  // exclusive end row of each run
+    uint8_t codeWidth = 0;          // 8 or 16 when rows are coded, 0 for runs
+    std::vector<uint8_t> codes;
+
+    static RunLengthColumn encode(const std::vector<uint32_t>& values);
+
+    bool isRunLength() const { return codeWidth == 0; }
+
+    uint32_t get(size_t row) const;
+
+    // Rows whose value lies in [low, high]
+    void filterRange(uint32_t low, uint32_t high, Selection& selection) const;
+
+    // Calls fn(begin, end, value) for each run of equal values in row order
+    template <typename Fn>
+    void forEachRun(Fn&& fn) const {
+        if (isRunLength()) {
+            uint32_t runStart = 0;
+            for (size_t r = 0; r < values.size(); ++r) {
+                fn(runStart, runEnds[r], values[r]);
+                runStart = runEnds[r];
+            }
+            return;
+        }
+        const size_t rows = codes.size() / (codeWidth / 8);
+        for (size_t row = 0; row < rows; ++row) {
+            fn(static_cast<uint32_t>(row), static_cast<uint32_t>(row + 1), values[code(row)]);
+        }
+    }
+
+    size_t memoryUsage() const {
+        return (values.size() + runEnds.size()) * sizeof(uint32_t) + codes.size();
+    }
+
+private:
+    uint32_t code(size_t row) const {
+        return codeWidth == 8 ? codes[row] : reinterpret_cast<const uint16_t*>(codes.data())[row];
+    }
+};
+
+// Frame-of-reference encoding for scaled decimals (fares in cents): each row
+// stores value - base in 8, 16 or 32 bits. Sums are exact integer arithmetic.
+struct FrameOfReferenceColumn {
+    static constexpr double SCALE = 100.0;
+
+    int64_t base = 0;
+    uint8_t width = 32;
+    size_t length = 0;
+    std::vector<uint8_t> bytes;
+
+    static FrameOfReferenceColumn encode(const std::vector<double>& values);
+
+    double get(size_t row) const { return (base + offset(row)) / SCALE; }
+    double sumSelected(const Selection& selection) const;
+
+    size_t memoryUsage() const { return bytes.size(); }
+
+private:
+    uint32_t offset(size_t row) const {
+        switch (width) {
+            case 8: return bytes[row];
+            case 16: return reinterpret_cast<const uint16_t*>(bytes.data())[row];
+            default: return reinterpret_cast<const uint32_t*>(bytes.data())[row];
+        }
+    }
+};
+
+// Compressed columnar copy of the trip file, kept in memory or saved to disk
+class ColumnStore {
+public:
+    static ColumnStore build(const TripRecord* records, size_t count);
+
+    // Column masks for load(); unrequested columns stay empty
+    static constexpr uint32_t VENDOR_COLUMN = 1 << 0;
+    static constexpr uint32_t PAYMENT_COLUMN = 1 << 1;
+    static constexpr uint32_t FLAG_COLUMN = 1 << 2;
+    static constexpr uint32_t PASSENGERS_COLUMN = 1 << 3;
+    static constexpr uint32_t DATE_COLUMN = 1 << 4;
+    static constexpr uint32_t FARE_COLUMN = 1 << 5;
+    static constexpr uint32_t TIP_COLUMN = 1 << 6;
+    static constexpr uint32_t DISTANCE_COLUMN = 1 << 7;
+    static constexpr uint32_t ALL_COLUMNS = 0xFF;
+
+    void save(const std::string& filename) const;
+    // Reads the columns in the mask and seeks past the others
+    static ColumnStore load(const std::string& filename, uint32_t columns = ALL_COLUMNS);
+
+    // Selection with every row set
+    Selection selectAll() const;
+    static size_t countSelected(const Selection& selection);
+
+    size_t memoryUsage() const;
+
+    size_t rowCount = 0;
+    DictionaryColumn vendor;
+    DictionaryColumn payment;
+    DictionaryColumn flag;
+    DictionaryColumn passengers;
+    RunLengthColumn date;
+    FrameOfReferenceColumn fare;
+    FrameOfReferenceColumn tip;
+    FrameOfReferenceColumn distance;
+};
+
+#endif
@@ -0,0 +1,463 @@
+#include <windows.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include <omp.h>
+#include <zlib.h>
+#include <zstd.h>
+#include "CompressedInput.hpp"
+#include "reader.hpp"
+
+namespace {
+
+using Buffer = std::unique_ptr<std::vector<char>>;
+
+// Blocking FIFO shared by pipeline stages; close() wakes all waiters
+template <typename T>
+class BlockingQueue {
+public:
+    explicit BlockingQueue(size_t capacity = SIZE_MAX) : capacity(capacity) {}
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [&] { return closed || items.size() < capacity; });
+        if (closed) return false;
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // Returns false once the queue is closed and drained
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [&] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+        notFull.notify_all();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    std::deque<T> items;
+    size_t capacity;
+    bool closed = false;
+};
+
+// Decoded bytes in file order, not yet split at line boundaries
+struct DecodedChunk {
+    size_t index = 0;
+    Buffer buffer;
+};
+
+// Whole lines for a parse worker: a range of a ring buffer, or a line that
+// straddled two chunks and was stitched into its own small allocation
+struct WorkItem {
+    size_t sequence = 0;
+    Buffer buffer;
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<char> stitched;
+};
+
+// Read-only view of the compressed file
+struct MappedFile {
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const char* data = nullptr;
+    size_t size = 0;
+
+    explicit MappedFile(const std::string& filename) {
+        fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Error opening file: " + filename);
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize)) {
+            CloseHandle(fileHandle);
+            throw std::runtime_error("Error getting file size");
+        }
+        size = static_cast<size_t>(fileSize.QuadPart);
+        if (size == 0) return;
+
+        mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+            CloseHandle(fileHandle);
+            throw std::runtime_error("Error creating file mapping");
+        }
+
+        data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!data) {
+            CloseHandle(mapping);
+            CloseHandle(fileHandle);
+            throw std::runtime_error("Error mapping view of file");
+        }
+    }
+
+    ~MappedFile() {
+        if (data) UnmapViewOfFile(const_cast<char*>(data));
+        if (mapping) CloseHandle(mapping);
+        CloseHandle(fileHandle);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+};
+
+// Inflates a gzip file (including multi-member files) chunk by chunk
+void decodeGzip(const MappedFile& file, BlockingQueue<Buffer>& freeBuffers,
+                BlockingQueue<DecodedChunk>& decoded) {
+    z_stream stream{};
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) {
+        throw std::runtime_error("Error initialising gzip decoder");
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(file.data));
+    size_t remaining = file.size;
+    size_t index = 0;
+
+    try {
+        bool done = file.size == 0;
+        // Input may only run out right after a member's trailer
+        bool memberEnded = true;
+        while (!done) {
+            Buffer buffer;
+            if (!freeBuffers.pop(buffer)) break;
+            buffer->resize(Reader::CHUNK_SIZE);
+            stream.next_out = reinterpret_cast<Bytef*>(buffer->data());
+            stream.avail_out = static_cast<uInt>(buffer->size());
+
+            while (stream.avail_out > 0) {
+                if (stream.avail_in == 0) {
+                    if (remaining == 0) {
+                        if (!memberEnded) throw std::runtime_error("Truncated gzip input");
+                        done = true;
+                        break;
+                    }
+                    // avail_in is 32-bit, so very large inputs are fed in slices
+                    stream.avail_in = static_cast<uInt>(std::min<size_t>(remaining, UINT32_MAX));
+                    remaining -= stream.avail_in;
+                }
+
+                int status = inflate(&stream, Z_NO_FLUSH);
+                memberEnded = status == Z_STREAM_END;
+                if (status == Z_STREAM_END) {
+                    // Concatenated members continue with a fresh header
+                    if (stream.avail_in == 0 && remaining == 0) {
+                        done = true;
+                        break;
+                    }
+                    inflateReset(&stream);
+                } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                    throw std::runtime_error(std::string("Corrupt gzip input: ") + (stream.msg ? stream.msg : "unknown error"));
+                } else if (status == Z_BUF_ERROR && stream.avail_in == 0 && remaining == 0) {
+                    throw std::runtime_error("Truncated gzip input");
+                }
+            }
+
+            buffer->resize(buffer->size() - stream.avail_out);
+            if (!decoded.push(DecodedChunk{index++, std::move(buffer)})) break;
+        }
+    } catch (...) {
+        inflateEnd(&stream);
+        throw;
+    }
+    inflateEnd(&stream);
+}
+
+// Streams a single zstd frame (or any zstd input) sequentially, chunk by chunk
+void decodeZstdStream(const MappedFile& file, BlockingQueue<Buffer>& freeBuffers,
+                      BlockingQueue<DecodedChunk>& decoded) {
+    std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    if (!context) {
+        throw std::runtime_error("Error initialising zstd decoder");
+    }
+
+    ZSTD_inBuffer input{file.data, file.size, 0};
+    size_t index = 0;
+    // 0 once the last frame has been fully decoded and flushed
+    size_t status = 0;
+    // A full output buffer may leave decoded data inside the context
+    bool outputFull = false;
+    while (input.pos < input.size || outputFull) {
+        Buffer buffer;
+        if (!freeBuffers.pop(buffer)) return;
+        buffer->resize(Reader::CHUNK_SIZE);
+        ZSTD_outBuffer output{buffer->data(), buffer->size(), 0};
+
+        do {
+            status = ZSTD_decompressStream(context.get(), &output, &input);
+            if (ZSTD_isError(status)) {
+                throw std::runtime_error(std::string("Corrupt zstd input: ") + ZSTD_getErrorName(status));
+            }
+        } while (output.pos < output.size && input.pos < input.size);
+        outputFull = output.pos == output.size;
+
+        buffer->resize(output.pos);
+        if (!decoded.push(DecodedChunk{index++, std::move(buffer)})) return;
+    }
+    if (status != 0) {
+        throw std::runtime_error("Truncated zstd input");
+    }
+}
+
+// Offsets of every zstd frame, found from frame headers without decoding
+std::vector<std::pair<size_t, size_t>> findZstdFrames(const MappedFile& file) {
+    std::vector<std::pair<size_t, size_t>> frames;
+    size_t offset = 0;
+    while (offset < file.size) {
+        size_t frameSize = ZSTD_findFrameCompressedSize(file.data + offset, file.size - offset);
+        if (ZSTD_isError(frameSize)) {
+            throw std::runtime_error(std::string("Corrupt zstd input: ") + ZSTD_getErrorName(frameSize));
+        }
+        frames.emplace_back(offset, frameSize);
+        offset += frameSize;
+    }
+    return frames;
+}
+
+// Decodes whole frames; frame indices are claimed only after a buffer is held,
+// so the frame the stitcher waits for next can always complete
+void decodeZstdFrames(const MappedFile& file, const std::vector<std::pair<size_t, size_t>>& frames,
+                      std::atomic<size_t>& nextFrame, BlockingQueue<Buffer>& freeBuffers,
+                      BlockingQueue<DecodedChunk>& decoded) {
+    std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+    if (!context) {
+        throw std::runtime_error("Error initialising zstd decoder");
+    }
+
+    while (true) {
+        Buffer buffer;
+        if (!freeBuffers.pop(buffer)) return;
+        const size_t index = nextFrame++;
+        if (index >= frames.size()) {
+            freeBuffers.push(std::move(buffer));
+            return;
+        }
+
+        const char* src = file.data + frames[index].first;
+        const size_t srcSize = frames[index].second;
+        const unsigned long long contentSize = ZSTD_getFrameContentSize(src, srcSize);
+
+        if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN && contentSize != ZSTD_CONTENTSIZE_ERROR) {
+            buffer->resize(static_cast<size_t>(contentSize));
+            size_t written = ZSTD_decompressDCtx(context.get(), buffer->data(), buffer->size(), src, srcSize);
+            if (ZSTD_isError(written)) {
+                throw std::runtime_error(std::string("Corrupt zstd input: ") + ZSTD_getErrorName(written));
+            }
+            buffer->resize(written);
+        } else {
+            // Frame header omits the size: stream into a growing buffer
+            ZSTD_DCtx_reset(context.get(), ZSTD_reset_session_only);
+            ZSTD_inBuffer input{src, srcSize, 0};
+            buffer->resize(Reader::CHUNK_SIZE);
+            size_t used = 0;
+            // 0 once the frame is fully decoded; a full output may leave data in the context
+            size_t status = 1;
+            bool outputFull = false;
+            while (input.pos < input.size || (status != 0 && outputFull)) {
+                if (used == buffer->size()) buffer->resize(buffer->size() * 2);
+                ZSTD_outBuffer output{buffer->data() + used, buffer->size() - used, 0};
+                status = ZSTD_decompressStream(context.get(), &output, &input);
+                if (ZSTD_isError(status)) {
+                    throw std::runtime_error(std::string("Corrupt zstd input: ") + ZSTD_getErrorName(status));
+                }
+                used += output.pos;
+                outputFull = output.pos == output.size;
+            }
+            if (status != 0) {
+                throw std::runtime_error("Truncated zstd input");
+            }
+            buffer->resize(used);
+        }
+
+        if (!decoded.push(DecodedChunk{index, std::move(buffer)})) return;
+    }
+}
+
+// Restores chunk order and cuts the stream at line boundaries. Only the line
+// spanning two chunks is copied; everything else is handed out in place.
+void stitchLines(BlockingQueue<DecodedChunk>& decoded, BlockingQueue<Buffer>& freeBuffers,
+                 BlockingQueue<WorkItem>& work) {
+    std::map<size_t, Buffer> pending;
+    std::vector<char> carry;
+    size_t nextIndex = 0;
+    size_t sequence = 0;
+
+    DecodedChunk chunk;
+    while (decoded.pop(chunk)) {
+        pending.emplace(chunk.index, std::move(chunk.buffer));
+
+        for (auto it = pending.find(nextIndex); it != pending.end(); it = pending.find(++nextIndex)) {
+            Buffer buffer = std::move(it->second);
+            pending.erase(it);
+
+            const char* data = buffer->data();
+            const size_t size = buffer->size();
+            const char* firstNewline = std::find(data, data + size, '\n');
+
+            if (firstNewline == data + size) {
+                carry.insert(carry.end(), data, data + size);
+                freeBuffers.push(std::move(buffer));
+                continue;
+            }
+
+            size_t begin = 0;
+            if (!carry.empty()) {
+                carry.insert(carry.end(), data, firstNewline + 1);
+                WorkItem item;
+                item.sequence = sequence++;
+                item.stitched = std::move(carry);
+                carry.clear();
+                if (!work.push(std::move(item))) return;
+                begin = firstNewline + 1 - data;
+            }
+
+            size_t end = size;
+            while (end > begin && data[end - 1] != '\n') end--;
+            carry.assign(data + end, data + size);
+
+            if (end > begin) {
+                WorkItem item;
+                item.sequence = sequence++;
+                item.buffer = std::move(buffer);
+                item.begin = begin;
+                item.end = end;
+                if (!work.push(std::move(item))) return;
+            } else {
+                freeBuffers.push(std::move(buffer));
+            }
+        }
+    }
+
+    // Final line without a trailing newline
+    if (!carry.empty()) {
+        WorkItem item;
+        item.sequence = sequence++;
+        item.stitched = std::move(carry);
+        work.push(std::move(item));
+    }
+}
+
+} // namespace
+
+Compression detectCompression(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    unsigned char magic[4] = {0, 0, 0, 0};
+    in.read(reinterpret_cast<char*>(magic), sizeof(magic));
+
+    if (in.gcount() >= 2 && magic[0] == 0x1F && magic[1] == 0x8B) return Compression::Gzip;
+    if (in.gcount() == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+void forEachDecompressedBlock(const std::string& filename, Compression compression,
+                              int numWorkers, const BlockHandler& handler) {
+    const MappedFile file(filename);
+
+    std::vector<std::pair<size_t, size_t>> frames;
+    if (compression == Compression::Zstd) frames = findZstdFrames(file);
+    const bool parallelFrames = frames.size() > 1;
+    const int numDecoders = parallelFrames ? std::max(1, numWorkers / 4) : 1;
+
+    // Ring of reusable buffers: enough for every decoder and worker to hold one
+    // while the next is being filled; this bounds memory use of the pipeline
+    const size_t ringSize = static_cast<size_t>(numDecoders + numWorkers) + 2;
+    BlockingQueue<Buffer> freeBuffers;
+    for (size_t i = 0; i < ringSize; ++i) {
+        freeBuffers.push(std::make_unique<std::vector<char>>());
+    }
+    BlockingQueue<DecodedChunk> decoded;
+    BlockingQueue<WorkItem> work(ringSize);
+
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    auto fail = [&](std::exception_ptr e) {
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = e;
+        }
+        freeBuffers.close();
+        decoded.close();
+        work.close();
+    };
+
+    // Decoder threads
+    std::atomic<size_t> nextFrame{0};
+    std::atomic<int> activeDecoders{numDecoders};
+    std::vector<std::thread> decoders;
+    for (int d = 0; d < numDecoders; ++d) {
+        decoders.emplace_back([&] {
+            try {
+                if (compression == Compression::Gzip) {
+                    decodeGzip(file, freeBuffers, decoded);
+                } else if (parallelFrames) {
+                    decodeZstdFrames(file, frames, nextFrame, freeBuffers, decoded);
+                } else {
+                    decodeZstdStream(file, freeBuffers, decoded);
+                }
+            } catch (...) {
+                fail(std::current_exception());
+            }
+            if (--activeDecoders == 0) decoded.close();
+        });
+    }
+
+    // Stitcher thread
+    std::thread stitcher([&] {
+        try {
+            stitchLines(decoded, freeBuffers, work);
+        } catch (...) {
+            fail(std::current_exception());
+        }
+        work.close();
+    });
+
+    // Parse workers
+    #pragma omp parallel num_threads(numWorkers)
+    {
+        const int worker = omp_get_thread_num();
+        WorkItem item;
+        while (work.pop(item)) {
+            try {
+                if (item.buffer) {
+                    handler(item.buffer->data() + item.begin, item.buffer->data() + item.end, worker, item.sequence);
+                    freeBuffers.push(std::move(item.buffer));
+                } else {
+                    handler(item.stitched.data(), item.stitched.data() + item.stitched.size(), worker, item.sequence);
+                }
+            } catch (...) {
+                fail(std::current_exception());
+            }
+        }
+    }
+
+    stitcher.join();
+    for (std::thread& decoder : decoders) decoder.join();
+
+    if (error) std::rethrow_exception(error);
+}
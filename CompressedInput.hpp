@@ -0,0 +1,24 @@
+#ifndef COMPRESSEDINPUT_HPP
+#define COMPRESSEDINPUT_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// Input formats recognised by their leading magic bytes
+enum class Compression { None, Gzip, Zstd };
+
+Compression detectCompression(const std::string& filename);
+
+// Receives one block of whole lines. sequence numbers blocks in file order,
+// so callers that need the original row order can reassemble it.
+using BlockHandler = std::function<void(const char* begin, const char* end, int worker, size_t sequence)>;
+
+// Decompresses a gzip or zstd file on background threads into a bounded ring
+// of buffers and feeds line-aligned blocks to numWorkers OpenMP parse workers.
+// Multi-frame zstd files (e.g. from pzstd or zstd -T) decode frames in
+// parallel; gzip and single-frame zstd decode on one pipelined thread.
+void forEachDecompressedBlock(const std::string& filename, Compression compression,
+                              int numWorkers, const BlockHandler& handler);
+
+#endif
@@ -0,0 +1,215 @@
+#include <windows.h>
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <omp.h>
+#include "Coordinator.hpp"
+#include "CompressedInput.hpp"
+#include "SpillAggregator.hpp"
+#include "reader.hpp"
+
+namespace {
+
+// Splits a plain file into equal byte ranges; workers realign them to lines.
+// Compressed streams cannot be entered mid-file, so they run as one shard.
+std::vector<ByteRange> planShards(const std::string& filename, int numWorkers) {
+    if (detectCompression(filename) != Compression::None) {
+        return {ByteRange{}};
+    }
+
+    const uint64_t fileSize = std::filesystem::file_size(filename);
+    std::vector<ByteRange> shards(numWorkers);
+    for (int i = 0; i < numWorkers; ++i) {
+        shards[i].begin = fileSize * i / numWorkers;
+        shards[i].end = fileSize * (i + 1) / numWorkers;
+    }
+    return shards;
+}
+
+// Quotes one argument so CommandLineToArgvW (and the CRT) parse it back
+// unchanged: backslashes are literal unless they precede a quote, so runs
+// before an embedded quote or the closing quote are doubled
+std::string quoteArgument(const std::string& argument) {
+    std::string quoted = "\"";
+    size_t backslashes = 0;
+    for (char c : argument) {
+        if (c == '\\') {
+            backslashes++;
+            continue;
+        }
+        quoted.append(c == '"' ? 2 * backslashes + 1 : backslashes, '\\');
+        backslashes = 0;
+        quoted += c;
+    }
+    quoted.append(2 * backslashes, '\\');
+    return quoted + "\"";
+}
+
+// Full path of this executable, however long
+std::string executablePath() {
+    std::vector<char> buffer(MAX_PATH);
+    while (true) {
+        const DWORD length = GetModuleFileNameA(nullptr, buffer.data(), static_cast<DWORD>(buffer.size()));
+        if (length == 0) {
+            throw std::runtime_error("Error locating the query engine executable");
+        }
+        if (length < buffer.size()) return std::string(buffer.data(), length);
+        buffer.resize(buffer.size() * 2);
+    }
+}
+
+std::string workerCommandLine(const ByteRange& shard, const std::string& partialFile, size_t memoryBudget) {
+    // The program name is taken up to the closing quote, without escapes
+    std::string commandLine = "\"" + executablePath() + "\"";
+    for (const auto& argument : workerArguments()) {
+        commandLine += " " + quoteArgument(argument);
+    }
+    if (!shard.isWholeFile()) {
+        commandLine += " --shard=" + std::to_string(shard.begin) + ":" + std::to_string(shard.end);
+    }
+    if (memoryBudget) {
+        commandLine += " --memory-budget-bytes=" + std::to_string(memoryBudget);
+    }
+    commandLine += " " + quoteArgument("--partial-output=" + partialFile);
+    return commandLine;
+}
+
+// Starts a worker process; returns nullptr if it could not be created
+HANDLE launchWorker(const std::string& commandLine) {
+    STARTUPINFOA startup{};
+    startup.cb = sizeof(startup);
+    PROCESS_INFORMATION process{};
+
+    // CreateProcessA may modify the command line buffer
+    std::vector<char> buffer(commandLine.begin(), commandLine.end());
+    buffer.push_back('\0');
+    if (!CreateProcessA(nullptr, buffer.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr,
+                        &startup, &process)) {
+        return nullptr;
+    }
+    CloseHandle(process.hThread);
+    return process.hProcess;
+}
+
+// Waits for a worker and returns its exit code
+DWORD waitForWorker(HANDLE process) {
+    WaitForSingleObject(process, INFINITE);
+    DWORD exitCode = 1;
+    GetExitCodeProcess(process, &exitCode);
+    CloseHandle(process);
+    return exitCode;
+}
+
+} // namespace
+
+uint32_t checkPartial(const std::string& path, const std::string& query) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Missing partial aggregate file: " + path);
+    }
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    uint32_t nameLength = 0;
+    in.read(magic, sizeof(magic));
+    readPod(in, version);
+    readPod(in, nameLength);
+    if (!in || !std::equal(magic, magic + 4, PARTIAL_MAGIC) || version != PARTIAL_VERSION ||
+        nameLength != query.size()) {
+        throw std::runtime_error("Not a supported partial aggregate file: " + path);
+    }
+
+    std::string name(nameLength, '\0');
+    in.read(name.data(), nameLength);
+    uint32_t valueSize = 0;
+    readPod(in, valueSize);
+    if (!in || name != query) {
+        throw std::runtime_error("Partial aggregate was written for another query: " + path);
+    }
+
+    // Keys and values must be present in full; a crashed worker leaves a short file
+    uint64_t keyCount = 0;
+    readPod(in, keyCount);
+    const uint64_t headerSize = sizeof(PARTIAL_MAGIC) + 3 * sizeof(uint32_t) + nameLength;
+    const uint64_t expectedSize = headerSize + 2 * sizeof(uint64_t) + keyCount * (sizeof(uint64_t) + valueSize);
+    if (!in || std::filesystem::file_size(path) != expectedSize) {
+        throw std::runtime_error("Truncated partial aggregate file: " + path);
+    }
+    return valueSize;
+}
+
+std::vector<std::string> runShards(const std::string& query, const std::string& filename) {
+    if (workerArguments().empty()) {
+        throw std::runtime_error("No worker arguments configured for sharded execution");
+    }
+
+    const std::vector<ByteRange> shards = planShards(filename, shardWorkers());
+    const size_t numShards = shards.size();
+
+    std::filesystem::path dir = spillDirectory().empty()
+        ? std::filesystem::temp_directory_path()
+        : std::filesystem::path(spillDirectory());
+    std::vector<std::string> paths(numShards);
+    for (size_t i = 0; i < numShards; ++i) {
+        paths[i] = (dir / ("query_engine_partial_" + std::to_string(GetCurrentProcessId()) +
+                           "_" + std::to_string(i) + ".bin")).string();
+    }
+
+    // Workers share the cores instead of each starting a full thread team, and
+    // split the aggregation memory budget so together they stay within it
+    const int workerThreads = std::max<int>(1, omp_get_max_threads() / static_cast<int>(numShards));
+    SetEnvironmentVariableA("OMP_NUM_THREADS", std::to_string(workerThreads).c_str());
+    const size_t workerBudget = aggregationMemoryBudget()
+        ? std::max<size_t>(1, aggregationMemoryBudget() / numShards) : 0;
+
+    std::vector<size_t> pending(numShards);
+    for (size_t i = 0; i < numShards; ++i) pending[i] = i;
+
+    for (int attempt = 1; !pending.empty(); ++attempt) {
+        if (attempt > MAX_SHARD_ATTEMPTS) {
+            removePartials(paths);
+            throw std::runtime_error("Shard " + std::to_string(pending.front()) + " of " + filename +
+                                     " failed after " + std::to_string(MAX_SHARD_ATTEMPTS) + " attempts");
+        }
+
+        // Launch every pending shard, then collect them in order
+        std::vector<HANDLE> processes(pending.size());
+        for (size_t k = 0; k < pending.size(); ++k) {
+            const size_t shard = pending[k];
+            std::error_code ignored;
+            std::filesystem::remove(paths[shard], ignored);
+            processes[k] = launchWorker(workerCommandLine(shards[shard], paths[shard], workerBudget));
+        }
+
+        std::vector<size_t> failed;
+        for (size_t k = 0; k < pending.size(); ++k) {
+            const size_t shard = pending[k];
+            std::string reason;
+            if (!processes[k]) {
+                reason = "could not start worker";
+            } else if (DWORD exitCode = waitForWorker(processes[k]); exitCode != 0) {
+                reason = "worker exited with code " + std::to_string(exitCode);
+            } else {
+                try {
+                    checkPartial(paths[shard], query);
+                } catch (const std::exception& e) {
+                    reason = e.what();
+                }
+            }
+
+            if (!reason.empty()) {
+                std::cerr << "Shard " << shard << " attempt " << attempt << " failed: " << reason << std::endl;
+                failed.push_back(shard);
+            }
+        }
+        pending.swap(failed);
+    }
+    return paths;
+}
+
+void removePartials(const std::vector<std::string>& paths) {
+    for (const auto& path : paths) {
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+    }
+}
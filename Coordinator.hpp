@@ -0,0 +1,151 @@
+#ifndef COORDINATOR_HPP
+#define COORDINATOR_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include "AggregateTable.hpp"
+#include "Serialization.hpp"
+
+// Number of local worker processes a grouped query is sharded across (0 or 1 = in-process)
+inline int& shardWorkers() {
+    static int workers = 0;
+    return workers;
+}
+
+// Set in a shard worker: the file its partial aggregate is written to
+inline std::string& partialOutput() {
+    static std::string path;
+    return path;
+}
+
+// Arguments this executable is relaunched with for each shard: query, input
+// file and the options every worker shares
+inline std::vector<std::string>& workerArguments() {
+    static std::vector<std::string> arguments;
+    return arguments;
+}
+
+// Launch attempts per shard before the query fails
+constexpr int MAX_SHARD_ATTEMPTS = 3;
+
+// Partial aggregate file: magic, format version, query name, serialized value
+// size, the group keys as a raw vector, then the value count and each value
+// written field by field with writePartialValue. Every Value type used with
+// shardedGroups provides writePartialValue(std::ostream&, const Value&) and
+// readPartialValue(std::istream&, Value&); bump PARTIAL_VERSION whenever one
+// of those layouts changes.
+constexpr char PARTIAL_MAGIC[4] = {'T', 'P', 'R', 'T'};
+constexpr uint32_t PARTIAL_VERSION = 2;
+
+// Bytes one value takes in a partial aggregate file
+template <typename Value>
+uint32_t partialValueSize() {
+    std::ostringstream out;
+    writePartialValue(out, Value{});
+    return static_cast<uint32_t>(out.tellp());
+}
+
+template <typename Value>
+void writePartial(const std::string& path, const std::string& query,
+                  const std::vector<std::pair<uint64_t, Value>>& groups) {
+    std::vector<uint64_t> keys;
+    keys.reserve(groups.size());
+    for (const auto& group : groups) keys.push_back(group.first);
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Error creating partial aggregate file: " + path);
+    }
+    out.write(PARTIAL_MAGIC, sizeof(PARTIAL_MAGIC));
+    writePod(out, PARTIAL_VERSION);
+    writePod(out, static_cast<uint32_t>(query.size()));
+    out.write(query.data(), query.size());
+    writePod(out, partialValueSize<Value>());
+    writeVector(out, keys);
+    writePod(out, static_cast<uint64_t>(groups.size()));
+    for (const auto& group : groups) writePartialValue(out, group.second);
+    if (!out) {
+        throw std::runtime_error("Error writing partial aggregate file: " + path);
+    }
+}
+
+// Reads the partial aggregate header and returns the value size it was written
+// with; throws unless the file is complete and was produced for this query
+uint32_t checkPartial(const std::string& path, const std::string& query);
+
+template <typename Value>
+std::vector<std::pair<uint64_t, Value>> readPartial(const std::string& path, const std::string& query) {
+    if (checkPartial(path, query) != partialValueSize<Value>()) {
+        throw std::runtime_error("Partial aggregate layout mismatch: " + path);
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(sizeof(PARTIAL_MAGIC) + 3 * sizeof(uint32_t) + query.size());
+    std::vector<uint64_t> keys;
+    uint64_t valueCount = 0;
+    readVector(in, keys);
+    readPod(in, valueCount);
+    if (!in || keys.size() != valueCount) {
+        throw std::runtime_error("Corrupt partial aggregate file: " + path);
+    }
+
+    std::vector<std::pair<uint64_t, Value>> groups(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+        groups[i].first = keys[i];
+        readPartialValue(in, groups[i].second);
+    }
+    if (!in) {
+        throw std::runtime_error("Corrupt partial aggregate file: " + path);
+    }
+    return groups;
+}
+
+// Runs one worker process per shard of filename and returns their partial
+// aggregate files in shard order. Failed shards are relaunched up to
+// MAX_SHARD_ATTEMPTS times. The caller removes the files.
+std::vector<std::string> runShards(const std::string& query, const std::string& filename);
+
+void removePartials(const std::vector<std::string>& paths);
+
+// Grouped aggregation of filename through scan(filename), which returns
+// (key, Value) groups; Value needs merge(). In-process by default, sharded
+// across shardWorkers() processes when set. A shard worker writes its groups
+// to partialOutput() and returns std::nullopt so nothing is reported twice.
+template <typename Value, typename Scan>
+std::optional<std::vector<std::pair<uint64_t, Value>>> shardedGroups(
+        const std::string& query, const std::string& filename, Scan scan) {
+    if (!partialOutput().empty()) {
+        writePartial(partialOutput(), query, scan(filename));
+        return std::nullopt;
+    }
+    if (shardWorkers() <= 1) {
+        return scan(filename);
+    }
+
+    const std::vector<std::string> paths = runShards(query, filename);
+    AggregateTable<Value> merged;
+    try {
+        for (const auto& path : paths) {
+            for (const auto& [key, value] : readPartial<Value>(path, query)) {
+                merged[key].merge(value);
+            }
+        }
+    } catch (...) {
+        removePartials(paths);
+        throw;
+    }
+    removePartials(paths);
+
+    std::vector<std::pair<uint64_t, Value>> groups;
+    groups.reserve(merged.size());
+    merged.forEach([&](uint64_t key, const Value& value) { groups.emplace_back(key, value); });
+    return groups;
+}
+
+#endif
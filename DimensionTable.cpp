@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#include "DimensionTable.hpp"
+#include "reader.hpp"
+
+std::vector<std::string> DimensionTable::splitCsvLine(std::string_view line) {
+    std::vector<std::string> fields;
+    std::string field;
+    bool quoted = false;
+
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+        } else if (c == ',' && !quoted) {
+            fields.push_back(std::move(field));
+            field.clear();
+        } else if (c != '\r') {
+            field.push_back(c);
+        }
+    }
+    fields.push_back(std::move(field));
+    return fields;
+}
+
+DimensionTable DimensionTable::load(const std::string& filename, size_t keyColumn) {
+    std::ifstream fin(filename);
+    if (!fin) {
+        throw std::runtime_error("Error opening dimension file: " + filename);
+    }
+
+    DimensionTable table;
+    std::string line;
+    if (!std::getline(fin, line)) {
+        throw std::runtime_error("Empty dimension file: " + filename);
+    }
+    table.names = splitCsvLine(line);
+    if (keyColumn >= table.names.size()) {
+        throw std::runtime_error("Join key column out of range in: " + filename);
+    }
+
+    const size_t numColumns = table.names.size();
+    table.dictionaries.resize(numColumns);
+    table.codes.resize(numColumns);
+    std::vector<std::unordered_map<std::string, uint32_t>> lookups(numColumns);
+    std::vector<int64_t> keys;
+
+    while (std::getline(fin, line)) {
+        if (line.empty() || line == "\r") continue;
+        auto fields = splitCsvLine(line);
+        fields.resize(numColumns);
+
+        for (size_t c = 0; c < numColumns; ++c) {
+            auto [it, inserted] = lookups[c].try_emplace(fields[c], static_cast<uint32_t>(table.dictionaries[c].size()));
+            if (inserted) table.dictionaries[c].push_back(fields[c]);
+            table.codes[c].push_back(it->second);
+        }
+        keys.push_back(Reader::parseInt(fields[keyColumn], -1));
+        table.rows++;
+    }
+
+    // Small key ranges (zone IDs are < 300) get a direct-indexed array
+    int64_t maxKey = -1;
+    for (int64_t key : keys) maxKey = std::max(maxKey, key);
+    if (maxKey >= 0 && static_cast<uint64_t>(maxKey) < DENSE_KEY_LIMIT) {
+        table.denseIndex.assign(maxKey + 1, NOT_FOUND);
+    }
+
+    for (size_t row = 0; row < keys.size(); ++row) {
+        const int64_t key = keys[row];
+        if (key < 0) continue;  // Unparseable keys can never match
+        if (static_cast<uint64_t>(key) < table.denseIndex.size()) {
+            table.denseIndex[key] = static_cast<int32_t>(row);
+        } else {
+            table.sparseIndex[static_cast<uint64_t>(key)] = static_cast<int32_t>(row);
+        }
+    }
+
+    return table;
+}
+
+size_t DimensionTable::columnIndex(const std::string& name) const {
+    for (size_t c = 0; c < names.size(); ++c) {
+        if (names[c] == name) return c;
+    }
+    throw std::runtime_error("Unknown dimension column: " + name);
+}
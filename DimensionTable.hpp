@@ -0,0 +1,52 @@
+#ifndef DIMENSIONTABLE_HPP
+#define DIMENSIONTABLE_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "AggregateTable.hpp"
+
+// Small read-only lookup table (e.g. taxi zone lookup) loaded once and probed
+// by all scan threads without locking. Attribute values are dictionary encoded,
+// so a joined attribute can be used directly as a dense group-by key.
+class DimensionTable {
+public:
+    static constexpr int32_t NOT_FOUND = -1;
+
+    // Loads a CSV with a header row; keyColumn holds the integer join key
+    static DimensionTable load(const std::string& filename, size_t keyColumn = 0);
+
+    // Row index for a join key, or NOT_FOUND
+    int32_t lookup(int64_t key) const {
+        if (key < 0) return NOT_FOUND;
+        if (static_cast<uint64_t>(key) < denseIndex.size()) {
+            return denseIndex[key];
+        }
+        const int32_t* row = sparseIndex.find(static_cast<uint64_t>(key));
+        return row ? *row : NOT_FOUND;
+    }
+
+    // Column position by header name, or throws if missing
+    size_t columnIndex(const std::string& name) const;
+
+    // Dictionary code of an attribute for a row; codes are dense in [0, cardinality)
+    uint32_t code(int32_t row, size_t column) const { return codes[column][row]; }
+    size_t cardinality(size_t column) const { return dictionaries[column].size(); }
+    const std::string& value(size_t column, uint32_t code) const { return dictionaries[column][code]; }
+
+    size_t rowCount() const { return rows; }
+    const std::vector<std::string>& columnNames() const { return names; }
+
+private:
+    static std::vector<std::string> splitCsvLine(std::string_view line);
+
+    std::vector<std::string> names;
+    std::vector<std::vector<std::string>> dictionaries;
+    std::vector<std::vector<uint32_t>> codes;
+    std::vector<int32_t> denseIndex;
+    AggregateTable<int32_t> sparseIndex{16};
+    size_t rows = 0;
+};
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SERIALIZATION_HPP
+#define SERIALIZATION_HPP
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+// Raw little-endian binary I/O for trivially copyable values and vectors of them.
+// Callers check the stream state once after a sequence of reads or writes.
+template <typename T>
+void writePod(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void writeVector(std::ostream& out, const std::vector<T>& values) {
+    writePod(out, static_cast<uint64_t>(values.size()));
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+void readPod(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+template <typename T>
+void readVector(std::istream& in, std::vector<T>& values) {
+    uint64_t size = 0;
+    readPod(in, size);
+    if (!in) return;
+    values.resize(size);
+    in.read(reinterpret_cast<char*>(values.data()), size * sizeof(T));
+}
+
+#endif
@@ -0,0 +1,383 @@
+#ifndef SPILLAGGREGATOR_HPP
+#define SPILLAGGREGATOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <omp.h>
+#include "AggregateTable.hpp"
+
+// Total memory allowed for aggregation state across all threads, in bytes (0 = unlimited)
+inline size_t& aggregationMemoryBudget() {
+    static size_t budget = 0;
+    return budget;
+}
+
+// Directory for spill files; empty means the system temp directory
+inline std::string& spillDirectory() {
+    static std::string directory;
+    return directory;
+}
+
+// Entries buffered per partition before a spill write
+constexpr size_t SPILL_BUFFER_ENTRIES = 256;
+
+// A detected dense key window may use at most 1/SPILL_DENSE_SHARE of the budget
+constexpr size_t SPILL_DENSE_SHARE = 4;
+
+// Smallest table memory a merge partition gets; below it fewer partitions merge at once
+constexpr size_t SPILL_MERGE_MIN_TABLE = size_t(1) << 16;
+
+// Deepest split level of an oversized merge partition (each level takes
+// MERGE_PARTITION_BITS more hash bits)
+constexpr size_t SPILL_MAX_SPLIT_LEVEL = 64 / MERGE_PARTITION_BITS - 1;
+
+// Partition of a key at a split level; level 0 is groupKeyPartition
+inline size_t groupKeySubPartition(uint64_t key, size_t level) {
+    return (hashGroupKey(key) >> (64 - MERGE_PARTITION_BITS * (level + 1))) & (MERGE_PARTITIONS - 1);
+}
+
+// Spill files can pass 2 GB, beyond the long offsets of fseek on Windows
+inline int seekSpillFile(std::FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, static_cast<long long>(offset), SEEK_SET);
+#else
+    return fseeko(file, static_cast<off_t>(offset), SEEK_SET);
+#endif
+}
+
+// Temp file of spilled entries for MERGE_PARTITIONS partitions. Every write
+// appends a segment and records its offset and entry count, so a single open
+// stream serves all partitions and reads verify they got what was written.
+template <typename Entry>
+class SpillFile {
+public:
+    SpillFile() : segments(MERGE_PARTITIONS) {
+        static std::atomic<uint64_t> sequence{0};
+        // Distinguishes spill files of concurrent processes sharing the directory
+        static const uint32_t processTag = std::random_device{}();
+        std::filesystem::path dir = spillDirectory().empty()
+            ? std::filesystem::temp_directory_path()
+            : std::filesystem::path(spillDirectory());
+        path = (dir / ("query_engine_spill_" + std::to_string(processTag) + "_" +
+                       std::to_string(sequence++) + ".bin")).string();
+        file = std::fopen(path.c_str(), "w+b");
+        if (!file) {
+            throw std::runtime_error("Error creating spill file: " + path);
+        }
+    }
+
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    ~SpillFile() {
+        std::fclose(file);
+        std::remove(path.c_str());
+    }
+
+    void append(size_t partition, const std::vector<Entry>& entries) {
+        for (size_t begin = 0; begin < entries.size(); begin += SPILL_BUFFER_ENTRIES) {
+            const size_t count = std::min(SPILL_BUFFER_ENTRIES, entries.size() - begin);
+            if (std::fwrite(entries.data() + begin, sizeof(Entry), count, file) != count) {
+                throw std::runtime_error("Error writing spill file: " + path);
+            }
+            segments[partition].push_back(Segment{bytes, count});
+            bytes += count * sizeof(Entry);
+        }
+    }
+
+    // Flushes buffered writes; required before the first read
+    void finish() {
+        if (std::fflush(file) != 0) {
+            throw std::runtime_error("Error writing spill file: " + path);
+        }
+    }
+
+    uint64_t entryCount(size_t partition) const {
+        uint64_t count = 0;
+        for (const Segment& segment : segments[partition]) count += segment.count;
+        return count;
+    }
+
+    // Calls fn(entry) for each entry of a partition until fn returns false;
+    // returns false if stopped early. Partitions may be read concurrently.
+    template <typename Fn>
+    bool read(size_t partition, Fn&& fn) {
+        std::vector<Entry> block(SPILL_BUFFER_ENTRIES);
+        for (const Segment& segment : segments[partition]) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (seekSpillFile(file, segment.offset) != 0 ||
+                    std::fread(block.data(), sizeof(Entry), segment.count, file) != segment.count) {
+                    throw std::runtime_error("Error reading spill file: " + path);
+                }
+            }
+            for (size_t i = 0; i < segment.count; ++i) {
+                if (!fn(block[i])) return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    struct Segment {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    std::FILE* file = nullptr;
+    std::string path;
+    uint64_t bytes = 0;
+    std::vector<std::vector<Segment>> segments;
+    std::mutex lock;
+};
+
+// Thread-local group-by table with a memory cap. Before a new group is added,
+// if the table already exceeds the budget or its next growth would, its groups
+// are hash-partitioned into a temp file and the table starts over empty.
+// Partial aggregates for the same key may therefore be spilled several times;
+// mergeSpilledGroups combines them. Small key ranges still aggregate in a dense
+// window (see GroupAggregator) capped to a budget share.
+template <typename Value>
+class SpillingAggregator {
+    static_assert(std::is_trivially_copyable<Value>::value,
+                  "Spilled aggregates are written as raw bytes");
+
+public:
+    struct Entry {
+        uint64_t key;
+        Value value;
+    };
+
+    explicit SpillingAggregator(size_t budgetBytes = 0)
+        : groups(0, budgetBytes ? budgetBytes / (SPILL_DENSE_SHARE * (sizeof(Value) + 1)) : DENSE_KEY_LIMIT),
+          budget(budgetBytes) {}
+
+    SpillingAggregator(const SpillingAggregator&) = delete;
+    SpillingAggregator& operator=(const SpillingAggregator&) = delete;
+    SpillingAggregator(SpillingAggregator&&) = default;
+    SpillingAggregator& operator=(SpillingAggregator&&) = default;
+
+    Value& operator[](uint64_t key) {
+        // Only a new hash table group adds memory; the budget test comes first
+        // so rows under budget skip the extra probe
+        if (budget && !groups.inDenseWindow(key) && overBudget() && !groups.sparse.find(key)) {
+            spill();
+        }
+        return groups[key];
+    }
+
+    bool hasSpilled() const { return spillFile != nullptr; }
+    size_t spillCount() const { return spills; }
+    size_t memoryBudget() const { return budget; }
+
+    // Appends every in-memory group to the spill file and empties the table
+    void spill() {
+        if (!spillFile) spillFile = std::make_unique<SpillFile<Entry>>();
+
+        std::vector<std::vector<Entry>> buffers(MERGE_PARTITIONS);
+        groups.forEach([&](uint64_t key, const Value& value) {
+            size_t p = groupKeyPartition(key);
+            buffers[p].push_back(Entry{key, value});
+            if (buffers[p].size() == SPILL_BUFFER_ENTRIES) {
+                spillFile->append(p, buffers[p]);
+                buffers[p].clear();
+            }
+        });
+        for (size_t p = 0; p < MERGE_PARTITIONS; ++p) {
+            spillFile->append(p, buffers[p]);
+        }
+
+        groups.clear();
+        spills++;
+    }
+
+    GroupAggregator<Value> groups;
+    std::unique_ptr<SpillFile<Entry>> spillFile;
+
+private:
+    // Over budget now, or the next hash table growth would be: growing briefly
+    // holds the old and the doubled slot arrays
+    bool overBudget() const {
+        if (groups.sparse.size() == 0) return false;
+        const size_t usage = groups.memoryUsage();
+        return usage > budget || (groups.sparse.needsGrow() && usage + 2 * groups.sparse.memoryUsage() > budget);
+    }
+
+    size_t budget = 0;
+    size_t spills = 0;
+};
+
+// Entries of one merge partition: partitions of spill files and in-memory runs
+template <typename Entry>
+struct SpillSource {
+    std::vector<std::pair<SpillFile<Entry>*, size_t>> files;
+    std::vector<const std::vector<Entry>*> runs;
+
+    // Calls fn(entry) until it returns false; returns false if stopped early
+    template <typename Fn>
+    bool forEach(Fn&& fn) const {
+        for (const auto& [file, partition] : files) {
+            if (!file->read(partition, fn)) return false;
+        }
+        for (const std::vector<Entry>* run : runs) {
+            for (const Entry& entry : *run) {
+                if (!fn(entry)) return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Merges one partition at a split level and hands its groups to onPartition.
+// With a tableBudget, a partition whose table would outgrow it is written to a
+// new spill file split on the next hash bits, and the pieces are merged in turn.
+template <typename Value, typename Entry, typename Fn>
+void mergeSpillPartition(const SpillSource<Entry>& source, size_t level, size_t tableBudget, Fn& onPartition) {
+    const bool canSplit = tableBudget && level < SPILL_MAX_SPLIT_LEVEL;
+    std::vector<std::pair<uint64_t, Value>> groups;
+    bool complete;
+    {
+        AggregateTable<Value> table(16);
+        complete = source.forEach([&](const Entry& entry) {
+            // Growing holds the old and the doubled slot arrays
+            if (canSplit && table.needsGrow() && 3 * table.memoryUsage() > tableBudget &&
+                !table.find(entry.key)) {
+                return false;
+            }
+            table[entry.key].merge(entry.value);
+            return true;
+        });
+        if (complete) {
+            groups.reserve(table.size());
+            table.forEach([&](uint64_t key, const Value& value) { groups.emplace_back(key, value); });
+        }
+    }
+    if (complete) {
+        if (!groups.empty()) onPartition(groups);
+        return;
+    }
+
+    SpillFile<Entry> split;
+    {
+        const size_t bufferEntries = std::clamp<size_t>(
+            tableBudget / (MERGE_PARTITIONS * sizeof(Entry)), 1, SPILL_BUFFER_ENTRIES);
+        std::vector<std::vector<Entry>> buffers(MERGE_PARTITIONS);
+        source.forEach([&](const Entry& entry) {
+            const size_t p = groupKeySubPartition(entry.key, level + 1);
+            buffers[p].push_back(entry);
+            if (buffers[p].size() == bufferEntries) {
+                split.append(p, buffers[p]);
+                buffers[p].clear();
+            }
+            return true;
+        });
+        for (size_t p = 0; p < MERGE_PARTITIONS; ++p) {
+            split.append(p, buffers[p]);
+        }
+        split.finish();
+    }
+
+    for (size_t p = 0; p < MERGE_PARTITIONS; ++p) {
+        if (split.entryCount(p) == 0) continue;
+        SpillSource<Entry> piece;
+        piece.files.emplace_back(&split, p);
+        mergeSpillPartition<Value>(piece, level + 1, tableBudget, onPartition);
+    }
+}
+
+// Merges thread-local spilling aggregators partition by partition. onPartition
+// receives the merged groups of one partition and may be called concurrently
+// from worker threads. With budgets set, only as many partitions merge at once
+// as the combined budget allows (after the groups of tables that never spilled),
+// and oversized partitions are split further instead of being loaded whole.
+template <typename Value, typename Fn>
+void mergeSpilledGroups(std::vector<SpillingAggregator<Value>>& locals, Fn&& onPartition) {
+    using Entry = typename SpillingAggregator<Value>::Entry;
+    const int numLocals = static_cast<int>(locals.size());
+
+    // Failures inside the parallel regions are rethrown once they end
+    std::exception_ptr error;
+    auto captureError = [&] {
+        #pragma omp critical
+        {
+            if (!error) error = std::current_exception();
+        }
+    };
+
+    // Phase 1: spilled tables flush their remainder to disk; others scatter in memory
+    std::vector<std::vector<std::vector<Entry>>> runs(numLocals);
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < numLocals; ++t) {
+        try {
+            auto& local = locals[t];
+            if (local.hasSpilled()) {
+                local.spill();
+                local.spillFile->finish();
+            } else {
+                runs[t].resize(MERGE_PARTITIONS);
+                local.groups.forEach([&](uint64_t key, const Value& value) {
+                    runs[t][groupKeyPartition(key)].push_back(Entry{key, value});
+                });
+                local.groups.clear();
+            }
+        } catch (...) {
+            captureError();
+        }
+    }
+    if (error) std::rethrow_exception(error);
+
+    // Merge tables share what the in-memory runs leave of the budget
+    size_t budget = 0;
+    size_t resident = 0;
+    for (int t = 0; t < numLocals; ++t) {
+        budget += locals[t].memoryBudget();
+        for (const auto& run : runs[t]) resident += run.capacity() * sizeof(Entry);
+    }
+    const int maxThreads = omp_get_max_threads();
+    int concurrency = maxThreads;
+    size_t tableBudget = 0;
+    if (budget) {
+        const size_t available = budget > resident ? budget - resident : 0;
+        concurrency = static_cast<int>(std::clamp<size_t>(available / SPILL_MERGE_MIN_TABLE, 1, maxThreads));
+        tableBudget = std::max(available / concurrency, SPILL_MERGE_MIN_TABLE);
+    }
+
+    // Phase 2: each partition is rebuilt from its spill file segments and runs
+    #pragma omp parallel for schedule(dynamic) num_threads(concurrency)
+    for (int p = 0; p < static_cast<int>(MERGE_PARTITIONS); ++p) {
+        try {
+            SpillSource<Entry> source;
+            for (int t = 0; t < numLocals; ++t) {
+                if (locals[t].hasSpilled()) {
+                    source.files.emplace_back(locals[t].spillFile.get(), p);
+                } else {
+                    source.runs.push_back(&runs[t][p]);
+                }
+            }
+            mergeSpillPartition<Value>(source, 0, tableBudget, onPartition);
+        } catch (...) {
+            captureError();
+        }
+        // Drop the partition's in-memory runs as soon as they have been consumed
+        for (int t = 0; t < numLocals; ++t) {
+            if (!runs[t].empty()) std::vector<Entry>().swap(runs[t][p]);
+        }
+    }
+
+    for (auto& local : locals) local.spillFile.reset();
+    if (error) std::rethrow_exception(error);
+}
+
+#endif
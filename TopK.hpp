@@ -0,0 +1,126 @@
+#ifndef TOPK_HPP
+#define TOPK_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+// ORDER BY column for grouped output (empty = natural key order)
+inline std::string& resultOrderBy() {
+    static std::string column;
+    return column;
+}
+
+// LIMIT for ordered output (0 = no limit)
+inline size_t& resultLimit() {
+    static size_t limit = 0;
+    return limit;
+}
+
+// Most items a TopKHeap reserves up front; k comes from --limit, so larger heaps
+// grow only as items actually arrive
+constexpr size_t TOPK_RESERVE_LIMIT = 4096;
+
+// Bounded heap keeping the k best items, where Better(a, b) means a ranks above b.
+// The worst kept item sits at the heap front, so threshold() is O(1) and lets a
+// scan skip rows that cannot enter the result.
+template <typename T, typename Better>
+class TopKHeap {
+public:
+    explicit TopKHeap(size_t k, Better better = Better()) : limit(k), better(better) {
+        items.reserve(std::min(k, TOPK_RESERVE_LIMIT));
+    }
+
+    bool full() const { return items.size() >= limit; }
+
+    // Worst item currently kept; only meaningful when full()
+    const T& threshold() const { return items.front(); }
+
+    void push(const T& item) {
+        if (limit == 0) return;
+        if (!full()) {
+            items.push_back(item);
+            std::push_heap(items.begin(), items.end(), better);
+        } else if (better(item, items.front())) {
+            std::pop_heap(items.begin(), items.end(), better);
+            items.back() = item;
+            std::push_heap(items.begin(), items.end(), better);
+        }
+    }
+
+    void merge(const TopKHeap& other) {
+        for (const T& item : other.items) push(item);
+    }
+
+    // Kept items, best first
+    std::vector<T> sorted() const {
+        std::vector<T> result = items;
+        std::sort(result.begin(), result.end(), better);
+        return result;
+    }
+
+private:
+    size_t limit;
+    Better better;
+    std::vector<T> items;
+};
+
+// Sorts in parallel: slices are sorted independently, then merged pairwise
+// with each round's merges running concurrently.
+template <typename T, typename Compare>
+void parallelSort(std::vector<T>& items, Compare compare) {
+    const size_t numSlices = std::max(1, omp_get_max_threads());
+    if (items.size() < 2 * numSlices * 1024) {
+        std::sort(items.begin(), items.end(), compare);
+        return;
+    }
+
+    std::vector<size_t> bounds(numSlices + 1);
+    for (size_t i = 0; i <= numSlices; ++i) bounds[i] = items.size() * i / numSlices;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < static_cast<int>(numSlices); ++i) {
+        std::sort(items.begin() + bounds[i], items.begin() + bounds[i + 1], compare);
+    }
+
+    for (size_t width = 1; width < numSlices; width *= 2) {
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < static_cast<int>(numSlices); i += static_cast<int>(2 * width)) {
+            if (i + width >= numSlices) continue;
+            const size_t hi = std::min<size_t>(i + 2 * width, numSlices);
+            std::inplace_merge(items.begin() + bounds[i], items.begin() + bounds[i + width],
+                               items.begin() + bounds[hi], compare);
+        }
+    }
+}
+
+// ORDER BY ... LIMIT k over an in-memory result: per-thread bounded heaps over
+// slices of the input, merged at the end. Returns at most k items, best first.
+// A k covering every item is a plain sort.
+template <typename T, typename Better>
+std::vector<T> parallelTopK(const std::vector<T>& items, size_t k, Better better) {
+    if (k >= items.size()) {
+        std::vector<T> result = items;
+        parallelSort(result, better);
+        return result;
+    }
+
+    const int numThreads = omp_get_max_threads();
+    std::vector<TopKHeap<T, Better>> heaps(numThreads, TopKHeap<T, Better>(k, better));
+
+    #pragma omp parallel num_threads(numThreads)
+    {
+        auto& heap = heaps[omp_get_thread_num()];
+        #pragma omp for schedule(static)
+        for (int64_t i = 0; i < static_cast<int64_t>(items.size()); ++i) {
+            heap.push(items[i]);
+        }
+    }
+
+    for (int i = 1; i < numThreads; ++i) heaps[0].merge(heaps[i]);
+    return heaps[0].sorted();
+}
+
+#endif
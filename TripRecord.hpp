@@ -4,6 +4,8 @@
 #include <string>
 #include <string_view>
 #include <cstring>
+#include <cstdint>
+#include <cstdio>
 
 // Optimized structure for faster processing
 struct TripRecord {
@@ -20,6 +22,10 @@ struct TripRecord {
     double tip = 0.0;
     int32_t passenger_count = 0;
 
+    // Pickup and dropoff as seconds since 1970-01-01 00:00:00 (0 if missing)
+    int64_t pickup_time = 0;
+    int64_t dropoff_time = 0;
+
     // Helper methods for date comparison
     bool isInJanuary2024() const {
         return strncmp(date, "2024-01", 7) == 0;
@@ -27,8 +33,65 @@ struct TripRecord {
 
     // Fast string view based getters
     std::string_view getDate() const { return std::string_view(date); }
+
+    int64_t getDurationSeconds() const {
+        return (pickup_time && dropoff_time) ? dropoff_time - pickup_time : 0;
+    }
+
+    // Both timestamps present and the dropoff not before the pickup
+    bool hasDuration() const {
+        return pickup_time && dropoff_time && dropoff_time >= pickup_time;
+    }
+
+    // Date packed as YYYYMMDD, usable directly as a group-by key
+    uint32_t getDateKey() const {
+        auto digit = [this](int i) { return static_cast<uint32_t>(date[i] - '0'); };
+        return (((digit(0) * 10 + digit(1)) * 10 + digit(2)) * 10 + digit(3)) * 10000
+             + (digit(5) * 10 + digit(6)) * 100
+             + (digit(8) * 10 + digit(9));
+    }
 };
 
+// Inverse of TripRecord::getDateKey
+inline std::string formatDateKey(uint32_t key) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%04u-%02u-%02u", key / 10000, (key / 100) % 100, key % 100);
+    return std::string(buf);
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (Hinnant's days_from_civil)
+inline int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+// Formats epoch seconds as YYYY-MM-DD HH:MM:SS (inverse of days_from_civil)
+inline std::string formatTimestamp(int64_t epochSeconds) {
+    int64_t days = epochSeconds / 86400;
+    int64_t secs = epochSeconds % 86400;
+    if (secs < 0) { secs += 86400; days--; }
+
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned d = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned m = mp < 10 ? mp + 3 : mp - 9;
+    const int64_t y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+
+    char buf[48];
+    std::snprintf(buf, sizeof(buf), "%04lld-%02u-%02u %02lld:%02lld:%02lld",
+                  static_cast<long long>(y), m, d, static_cast<long long>(secs / 3600),
+                  static_cast<long long>((secs / 60) % 60), static_cast<long long>(secs % 60));
+    return std::string(buf);
+}
+
 // Stats structure for aggregations
 struct Stats {
     size_t count = 0;
@@ -0,0 +1,26 @@
+#include <iostream>
+#include "reader.hpp"
+#include "ColumnStore.hpp"
+#include "BitmapIndex.hpp"
+
+// Converts a trip CSV into the compressed column format read by query8, plus
+// the bitmap index (<outputFile>.idx) read by query9
+void encodeColumns(const std::string& filename, const std::string& outputFile) {
+    try {
+        RecordBuffer records = Reader::readFile(filename);
+        ColumnStore store = ColumnStore::build(records.data(), records.size());
+        store.save(outputFile);
+
+        std::cerr << "Encoded " << store.rowCount << " rows: "
+                  << store.memoryUsage() << " bytes ("
+                  << (store.rowCount ? static_cast<double>(store.memoryUsage()) / store.rowCount : 0.0)
+                  << " bytes/row, uncompressed " << sizeof(TripRecord) << ")" << std::endl;
+
+        BitmapIndex index = BitmapIndex::build(store);
+        index.save(outputFile + ".idx");
+        std::cerr << "Bitmap index: " << index.memoryUsage() << " bytes" << std::endl;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
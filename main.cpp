@@ -1,22 +1,111 @@
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <cstdint>
+#include <optional>
+#include "SpillAggregator.hpp"
+#include "TopK.hpp"
+#include "Coordinator.hpp"
+#include "reader.hpp"
 
 // Forward declarations
 void query1(const std::string& filename);
 void query2(const std::string& filename);
 void query3(const std::string& filename);
 void query4(const std::string& filename);
+void query5(const std::string& filename, const std::string& dimensionFile,
+            size_t joinColumn, const std::string& groupColumn);
+void query6(const std::string& filename);
+void query7(const std::string& filename, int64_t windowMinutes, int64_t slideMinutes);
+void query8(const std::string& filename);
+void query9(const std::string& filename);
+void encodeColumns(const std::string& filename, const std::string& outputFile);
 
 int main(int argc, char* argv[]) {
     if (argc < 3) {
-        std::cerr << "Usage: ./query_engine <query1|query2|query3|query4> <input_file>" << std::endl;
+        std::cerr << "Usage: ./query_engine <query1|...|query9|encode> <input_file>"
+                  << " [--memory-budget=<MB>] [--spill-dir=<path>]"
+                  << " [--dimension=<lookup.csv>] [--join-column=<n>] [--group-by=<column>]"
+                  << " [--order-by=<column>] [--limit=<k>]"
+                  << " [--window=<minutes>] [--slide=<minutes>] [--output=<file>]"
+                  << " [--large-pages] [--workers=<n>]" << std::endl;
         return 1;
     }
 
     std::string query = argv[1];
     std::string filename = argv[2];
 
+    // Dimension join settings (query5). The trip layout read by Reader::parseLine
+    // has no fixed location ID column, so the join column must be given.
+    std::string dimensionFile;
+    std::optional<size_t> joinColumn;
+    std::string groupColumn = "Borough";
+
+    // Time window settings (query7); slide defaults to the window length (tumbling)
+    int64_t windowMinutes = 60;
+    int64_t slideMinutes = 0;
+
+    // Column file written by "encode"
+    std::string outputFile;
+
+    // Sharded runs relaunch this executable with the same query, input and options;
+    // the coordinator passes each worker its share of the memory budget instead
+    workerArguments() = {query, filename};
+
+    // Optional settings
+    for (int i = 3; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option.rfind("--workers=", 0) != 0 && option.rfind("--memory-budget=", 0) != 0) {
+            workerArguments().push_back(option);
+        }
+        try {
+            if (option.rfind("--memory-budget=", 0) == 0) {
+                aggregationMemoryBudget() = std::stoull(option.substr(16)) * 1024 * 1024;
+            } else if (option.rfind("--spill-dir=", 0) == 0) {
+                spillDirectory() = option.substr(12);
+            } else if (option.rfind("--dimension=", 0) == 0) {
+                dimensionFile = option.substr(12);
+            } else if (option.rfind("--join-column=", 0) == 0) {
+                joinColumn = std::stoull(option.substr(14));
+            } else if (option.rfind("--group-by=", 0) == 0) {
+                groupColumn = option.substr(11);
+            } else if (option.rfind("--order-by=", 0) == 0) {
+                resultOrderBy() = option.substr(11);
+            } else if (option.rfind("--limit=", 0) == 0) {
+                resultLimit() = std::stoull(option.substr(8));
+            } else if (option.rfind("--window=", 0) == 0) {
+                windowMinutes = std::stoll(option.substr(9));
+            } else if (option.rfind("--slide=", 0) == 0) {
+                slideMinutes = std::stoll(option.substr(8));
+            } else if (option.rfind("--output=", 0) == 0) {
+                outputFile = option.substr(9);
+            } else if (option == "--large-pages") {
+                useLargePages() = true;
+            } else if (option.rfind("--workers=", 0) == 0) {
+                shardWorkers() = std::stoi(option.substr(10));
+            } else if (option.rfind("--shard=", 0) == 0) {
+                // Internal: byte range scanned by a shard worker
+                const std::string range = option.substr(8);
+                const size_t colon = range.find(':');
+                if (colon == std::string::npos) throw std::invalid_argument(range);
+                scanRange().begin = std::stoull(range.substr(0, colon));
+                scanRange().end = std::stoull(range.substr(colon + 1));
+            } else if (option.rfind("--memory-budget-bytes=", 0) == 0) {
+                // Internal: a shard worker's share of the memory budget
+                aggregationMemoryBudget() = std::stoull(option.substr(22));
+            } else if (option.rfind("--partial-output=", 0) == 0) {
+                // Internal: where a shard worker writes its partial aggregate
+                partialOutput() = option.substr(17);
+            } else {
+                std::cerr << "Unknown option: " << option << std::endl;
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid option value: " << option << std::endl;
+            return 1;
+        }
+    }
+
     // Record start time
     auto start = std::chrono::high_resolution_clock::now();
 
@@ -29,6 +118,26 @@ int main(int argc, char* argv[]) {
             query3(filename);
         } else if (query == "query4") {
             query4(filename);
+        } else if (query == "query5") {
+            if (dimensionFile.empty() || !joinColumn) {
+                std::cerr << "query5 requires --dimension=<lookup.csv> and --join-column=<n>" << std::endl;
+                return 1;
+            }
+            query5(filename, dimensionFile, *joinColumn, groupColumn);
+        } else if (query == "query6") {
+            query6(filename);
+        } else if (query == "query7") {
+            query7(filename, windowMinutes, slideMinutes ? slideMinutes : windowMinutes);
+        } else if (query == "query8") {
+            query8(filename);
+        } else if (query == "query9") {
+            query9(filename);
+        } else if (query == "encode") {
+            if (outputFile.empty()) {
+                std::cerr << "encode requires --output=<file>" << std::endl;
+                return 1;
+            }
+            encodeColumns(filename, outputFile);
         } else {
             std::cerr << "Invalid query specified." << std::endl;
             return 1;
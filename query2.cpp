@@ -2,129 +2,126 @@
 #include <vector>
 #include <array>
 #include <immintrin.h>
-#include <windows.h>
 #include <iomanip>
+#include <algorithm>
 #include <omp.h>
 #include "reader.hpp"
+#include "Coordinator.hpp"
 
 // Structure to hold aggregated results per payment type
 struct PaymentStats {
     alignas(32) size_t count = 0;  // Align for SIMD operations
     alignas(32) double fare_sum = 0.0;
     alignas(32) double tip_sum = 0.0;
-};
-
-constexpr size_t MAX_PAYMENT_TYPES = 7; // Payment types 1-6
-constexpr double DISTANCE_THRESHOLD = 5.0;
-
-void query2(const std::string& filename) {
-    try {
-        // Memory map the file
-        HANDLE fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 
-            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-        if (fileHandle == INVALID_HANDLE_VALUE) {
-            throw std::runtime_error("Error opening file: " + filename);
-        }
-
-        // Thread-local statistics arrays (fixed size for payment types 1-6)
-        const int MAX_PAYMENT_TYPES = 7;
-        std::vector<std::vector<PaymentTypeStats>> threadStats(
-            omp_get_max_threads(), 
-            std::vector<PaymentTypeStats>(MAX_PAYMENT_TYPES)
-        );
 
-        // Set up buffered reading
-        std::vector<char> buffer(Reader::BUFFER_SIZE);
-        fin.rdbuf()->pubsetbuf(buffer.data(), Reader::BUFFER_SIZE);
-
-        const size_t chunkSize = fileSize.QuadPart / numThreads;
-
-        #pragma omp parallel num_threads(numThreads)
-        {
-            const int threadId = omp_get_thread_num();
-            size_t start = threadId * chunkSize;
-            size_t end = (threadId == numThreads - 1) ? fileSize.QuadPart : (threadId + 1) * chunkSize;
-
-            // Align chunks to newline boundaries
-            if (threadId > 0) {
-                while (start < end && data[start] != '\n') start++;
-            }
-            if (threadId < numThreads - 1) {
-                while (end < fileSize.QuadPart && data[end] != '\n') end++;
-            }
+    void merge(const PaymentStats& other) {
+        count += other.count;
+        fare_sum += other.fare_sum;
+        tip_sum += other.tip_sum;
+    }
+};
 
-            // Process records in this chunk
-            const char* curr = data + start;
-            const char* chunk_end = data + end;
-            auto& localStats = threadStats[threadId];
+// Partial aggregate layout for sharded runs (see writePartial)
+void writePartialValue(std::ostream& out, const PaymentStats& stats) {
+    writePod(out, static_cast<uint64_t>(stats.count));
+    writePod(out, stats.fare_sum);
+    writePod(out, stats.tip_sum);
+}
 
-            // Pre-load SIMD constants
-            const __m256d vThreshold = _mm256_set1_pd(DISTANCE_THRESHOLD);
+void readPartialValue(std::istream& in, PaymentStats& stats) {
+    uint64_t count = 0;
+    readPod(in, count);
+    stats.count = count;
+    readPod(in, stats.fare_sum);
+    readPod(in, stats.tip_sum);
+}
 
-            while (curr < chunk_end) {
-                const char* lineEnd = std::find(curr, chunk_end, '\n');
-                if (lineEnd == chunk_end) break;
+constexpr size_t MAX_PAYMENT_TYPES = 7; // Payment types 1-6
+constexpr double DISTANCE_THRESHOLD = 5.0;
 
-                std::string_view line(curr, lineEnd - curr);
-                try {
-                    TripRecord record = Reader::parseLine(std::string(line));
+// Payment type totals of long trips in one input (or shard), keyed by payment type
+std::vector<std::pair<uint64_t, PaymentStats>> scanPaymentStats(const std::string& filename) {
+    // Thread-local statistics arrays (fixed size for payment types 1-6)
+    const int numThreads = omp_get_max_threads();
+    std::vector<std::array<PaymentStats, MAX_PAYMENT_TYPES>> threadStats(numThreads);
+
+    Reader::scanFile(filename, [&](const char* chunk_start, const char* chunk_end, int threadId) {
+        // Process records in this chunk
+        const char* curr = chunk_start;
+        auto& localStats = threadStats[threadId];
+
+        // Pre-load SIMD constants
+        const __m256d vThreshold = _mm256_set1_pd(DISTANCE_THRESHOLD);
+
+        while (curr < chunk_end) {
+            const char* lineEnd = std::find(curr, chunk_end, '\n');
+            std::string_view line(curr, lineEnd - curr);
+            try {
+                TripRecord record = Reader::parseLine(std::string(line));
+                
+                // SIMD comparison for Trip_distance > 5.0
+                if (_mm256_movemask_pd(_mm256_cmp_pd(
+                        _mm256_set1_pd(record.Trip_distance), 
+                        vThreshold, 
+                        _CMP_GT_OQ)) && 
+                    record.Payment_type > 0 && 
+                    record.Payment_type < MAX_PAYMENT_TYPES) {
                     
-                    // SIMD comparison for Trip_distance > 5.0
-                    if (_mm256_movemask_pd(_mm256_cmp_pd(
-                            _mm256_set1_pd(record.Trip_distance), 
-                            vThreshold, 
-                            _CMP_GT_OQ)) && 
-                        record.Payment_type > 0 && 
-                        record.Payment_type < MAX_PAYMENT_TYPES) {
-                        
-                        auto& stats = localStats[record.Payment_type];
-                        stats.count++;
-                        stats.fare_sum += record.fare;
-                        stats.tip_sum += record.tip;
-                    }
-                } catch (const std::exception& e) {
-                    #pragma omp critical
-                    {
-                        std::cerr << "Error parsing line: " << e.what() << std::endl;
-                    }
+                    auto& stats = localStats[record.Payment_type];
+                    stats.count++;
+                    stats.fare_sum += record.fare;
+                    stats.tip_sum += record.tip;
+                }
+            } catch (const std::exception& e) {
+                #pragma omp critical
+                {
+                    std::cerr << "Error parsing line: " << e.what() << std::endl;
                 }
-
-                curr = lineEnd + 1;
             }
 
+            curr = lineEnd + 1;
         }
+    });
 
-        // Merge results using SIMD
-        std::array<PaymentStats, MAX_PAYMENT_TYPES> finalStats{};
-        for (const auto& threadStat : threadStats) {
-            for (size_t i = 1; i < MAX_PAYMENT_TYPES; ++i) {
-                __m256i vCount = _mm256_set1_epi64x(threadStat[i].count);
-                __m256d vFare = _mm256_set1_pd(threadStat[i].fare_sum);
-                __m256d vTip = _mm256_set1_pd(threadStat[i].tip_sum);
-
-                finalStats[i].count += _mm256_extract_epi64(vCount, 0);
-                finalStats[i].fare_sum += _mm256_cvtsd_f64(vFare);
-                finalStats[i].tip_sum += _mm256_cvtsd_f64(vTip);
-            }
+    // Merge results using SIMD
+    std::array<PaymentStats, MAX_PAYMENT_TYPES> finalStats{};
+    for (const auto& threadStat : threadStats) {
+        for (size_t i = 1; i < MAX_PAYMENT_TYPES; ++i) {
+            __m256i vCount = _mm256_set1_epi64x(threadStat[i].count);
+            __m256d vFare = _mm256_set1_pd(threadStat[i].fare_sum);
+            __m256d vTip = _mm256_set1_pd(threadStat[i].tip_sum);
+
+            finalStats[i].count += _mm256_extract_epi64(vCount, 0);
+            finalStats[i].fare_sum += _mm256_cvtsd_f64(vFare);
+            finalStats[i].tip_sum += _mm256_cvtsd_f64(vTip);
+        }
+    }
+
+    std::vector<std::pair<uint64_t, PaymentStats>> groups;
+    for (size_t i = 1; i < MAX_PAYMENT_TYPES; ++i) {
+        if (finalStats[i].count > 0) {
+            groups.emplace_back(i, finalStats[i]);
         }
+    }
+    return groups;
+}
+
+void query2(const std::string& filename) {
+    try {
+        auto groups = shardedGroups<PaymentStats>("query2", filename, scanPaymentStats);
+        if (!groups) return;  // shard worker: partial aggregate written for the coordinator
+        std::sort(groups->begin(), groups->end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
 
         // Output results with formatting
         std::cout << std::fixed << std::setprecision(2);
-        for (size_t i = 1; i < MAX_PAYMENT_TYPES; ++i) {
-            const auto& stats = finalStats[i];
-            if (stats.count > 0) {
-                std::cout << "Payment_type " << i << ": "
-                         << "count=" << stats.count << ", "
-                         << "fare_sum=" << stats.fare_sum << ", "
-                         << "tip_sum=" << stats.tip_sum << std::endl;
-            }
+        for (const auto& [paymentType, stats] : *groups) {
+            std::cout << "Payment_type " << paymentType << ": "
+                     << "count=" << stats.count << ", "
+                     << "fare_sum=" << stats.fare_sum << ", "
+                     << "tip_sum=" << stats.tip_sum << std::endl;
         }
 
-        // Cleanup
-        UnmapViewOfFile(data);
-        CloseHandle(mapping);
-        CloseHandle(fileHandle);
-
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
     }
@@ -1,12 +1,14 @@
 #include <iostream>
 #include <vector>
 #include <array>
-#include <map>
+#include <algorithm>
 #include <immintrin.h>
-#include <windows.h>
 #include <iomanip>
 #include <omp.h>
 #include "reader.hpp"
+#include "SpillAggregator.hpp"
+#include "TopK.hpp"
+#include "Coordinator.hpp"
 
 // Structure to hold daily statistics with SIMD-friendly alignment
 struct DailyStats {
@@ -17,7 +19,7 @@ struct DailyStats {
     alignas(32) double tip_sum = 0.0;
 
     // SIMD-optimized merge operation
-    void mergeWith(const DailyStats& other) {
+    void merge(const DailyStats& other) {
         __m256i vCount = _mm256_set1_epi64x(other.count);
         __m256i vPassenger = _mm256_set1_epi32(other.passenger_sum);
         __m256d vDistance = _mm256_set1_pd(other.distance_sum);
@@ -32,6 +34,37 @@ struct DailyStats {
     }
 };
 
+// Partial aggregate layout for sharded runs (see writePartial)
+void writePartialValue(std::ostream& out, const DailyStats& stats) {
+    writePod(out, static_cast<uint64_t>(stats.count));
+    writePod(out, stats.passenger_sum);
+    writePod(out, stats.distance_sum);
+    writePod(out, stats.fare_sum);
+    writePod(out, stats.tip_sum);
+}
+
+void readPartialValue(std::istream& in, DailyStats& stats) {
+    uint64_t count = 0;
+    readPod(in, count);
+    stats.count = count;
+    readPod(in, stats.passenger_sum);
+    readPod(in, stats.distance_sum);
+    readPod(in, stats.fare_sum);
+    readPod(in, stats.tip_sum);
+}
+
+using DailyOrderKey = double (*)(const DailyStats&);
+
+// Maps an --order-by column name to its value accessor
+DailyOrderKey dailyOrderKey(const std::string& column) {
+    if (column == "count") return [](const DailyStats& s) { return static_cast<double>(s.count); };
+    if (column == "passenger_sum") return [](const DailyStats& s) { return static_cast<double>(s.passenger_sum); };
+    if (column == "trip_distance_sum") return [](const DailyStats& s) { return s.distance_sum; };
+    if (column == "fare_sum") return [](const DailyStats& s) { return s.fare_sum; };
+    if (column == "tip_sum") return [](const DailyStats& s) { return s.tip_sum; };
+    throw std::runtime_error("Unknown order-by column: " + column);
+}
+
 // Optimized date comparison using SIMD
 inline bool isJanuary2024SIMD(const char* date) {
     static const __m128i target = _mm_loadu_si128(reinterpret_cast<const __m128i*>("2024-01"));
@@ -39,106 +72,90 @@ inline bool isJanuary2024SIMD(const char* date) {
     return (_mm_movemask_epi8(_mm_cmpeq_epi8(target, input)) & 0x7F) == 0x7F;
 }
 
-void query4(const std::string& filename) {
-    try {
-        // Memory map the file
-        HANDLE fileHandle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 
-            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
-        if (fileHandle == INVALID_HANDLE_VALUE) {
-            throw std::runtime_error("Error opening file: " + filename);
-        }
-
-        LARGE_INTEGER fileSize;
-        if (!GetFileSizeEx(fileHandle, &fileSize)) {
-            CloseHandle(fileHandle);
-            throw std::runtime_error("Error getting file size");
-        }
-
-        HANDLE mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
-        if (!mapping) {
-            CloseHandle(fileHandle);
-            throw std::runtime_error("Error creating file mapping");
-        }
+// Daily totals of January trips in one input (or shard), keyed by packed YYYYMMDD date
+std::vector<std::pair<uint64_t, DailyStats>> scanDailyStats(const std::string& filename) {
+    // Initialize thread-local statistics
+    const int numThreads = omp_get_max_threads();
+    // Each thread gets an equal share of the aggregation memory budget
+    std::vector<SpillingAggregator<DailyStats>> threadStats;
+    threadStats.reserve(numThreads);
+    for (int i = 0; i < numThreads; ++i) {
+        threadStats.emplace_back(aggregationMemoryBudget() / numThreads);
+    }
+    Reader::scanFile(filename, [&](const char* chunk_start, const char* chunk_end, int threadId) {
+        // Process records in this chunk
+        const char* curr = chunk_start;
+        auto& localStats = threadStats[threadId];
+
+        while (curr < chunk_end) {
+            const char* lineEnd = std::find(curr, chunk_end, '\n');
+            std::string_view line(curr, lineEnd - curr);
+            curr = lineEnd + 1;
+
+            TripRecord record;
+            try {
+                record = Reader::parseLine(std::string(line));
+            } catch (const std::exception& e) {
+                #pragma omp critical
+                {
+                    std::cerr << "Error parsing line: " << e.what() << std::endl;
+                }
+                continue;
+            }
 
-        char* data = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
-        if (!data) {
-            CloseHandle(mapping);
-            CloseHandle(fileHandle);
-            throw std::runtime_error("Error mapping view of file");
+            // Aggregation stays outside the parse try: a failed spill fails the
+            // query instead of being logged as a bad row
+            if (isJanuary2024SIMD(record.date)) {
+                // Packed YYYYMMDD key avoids a string allocation per row
+                auto& stats = localStats[record.getDateKey()];
+                stats.count++;
+                stats.passenger_sum += record.passenger_count;
+                stats.distance_sum += record.Trip_distance;
+                stats.fare_sum += record.fare;
+                stats.tip_sum += record.tip;
+            }
         }
+    });
 
-        // Initialize thread-local statistics
-        const int numThreads = omp_get_max_threads();
-        std::vector<std::map<std::string, DailyStats>> threadStats(numThreads);
-        const size_t chunkSize = fileSize.QuadPart / numThreads;
-
-        #pragma omp parallel num_threads(numThreads)
+    // Partition-by-partition merge of in-memory and spilled partial aggregates
+    std::vector<std::pair<uint64_t, DailyStats>> finalStats;
+    mergeSpilledGroups(threadStats, [&](const std::vector<std::pair<uint64_t, DailyStats>>& groups) {
+        #pragma omp critical
         {
-            const int threadId = omp_get_thread_num();
-            size_t start = threadId * chunkSize;
-            size_t end = (threadId == numThreads - 1) ? fileSize.QuadPart : (threadId + 1) * chunkSize;
-
-            // Align chunks to newline boundaries
-            if (threadId > 0) {
-                while (start < end && data[start] != '\n') start++;
-            }
-            if (threadId < numThreads - 1) {
-                while (end < fileSize.QuadPart && data[end] != '\n') end++;
-            }
-
-            // Process records in this chunk
-            const char* curr = data + start;
-            const char* chunk_end = data + end;
-            auto& localStats = threadStats[threadId];
-
-            // Pre-allocate string for date key to avoid allocations in loop
-            std::string dateKey;
-            dateKey.reserve(10);  // YYYY-MM-DD
-
-            while (curr < chunk_end) {
-                const char* lineEnd = std::find(curr, chunk_end, '\n');
-                if (lineEnd == chunk_end) break;
-
-                std::string_view line(curr, lineEnd - curr);
-                try {
-                    TripRecord record = Reader::parseLine(std::string(line));
-                    
-                    // Fast date check using SIMD
-                    if (isJanuary2024SIMD(record.date)) {
-                        // Get the full date as key (YYYY-MM-DD)
-                        dateKey.assign(record.date, 10);
-                        auto& stats = localStats[dateKey];
-                        
-                        // Update statistics using SIMD
-                            stats.count++;
-                        stats.passenger_sum += record.passenger_count;
-                        stats.distance_sum += record.Trip_distance;
-                        stats.fare_sum += record.fare;
-                        stats.tip_sum += record.tip;
-                    }
-                } catch (const std::exception& e) {
-                    #pragma omp critical
-                    {
-                        std::cerr << "Error parsing line: " << e.what() << std::endl;
-                    }
-                }
-
-                curr = lineEnd + 1;
-            }
+            finalStats.insert(finalStats.end(), groups.begin(), groups.end());
         }
+    });
+    return finalStats;
+}
 
-        // Merge results from all threads
-        std::map<std::string, DailyStats> finalStats;
-        for (const auto& threadStat : threadStats) {
-            for (const auto& [date, stats] : threadStat) {
-                finalStats[date].mergeWith(stats);
+void query4(const std::string& filename) {
+    try {
+        auto groups = shardedGroups<DailyStats>("query4", filename, scanDailyStats);
+        if (!groups) return;  // shard worker: partial aggregate written for the coordinator
+        auto& finalStats = *groups;
+
+        if (resultOrderBy().empty()) {
+            // Packed keys sort in calendar order
+            parallelSort(finalStats, [](const auto& a, const auto& b) { return a.first < b.first; });
+            if (resultLimit() && finalStats.size() > resultLimit()) finalStats.resize(resultLimit());
+        } else {
+            // ORDER BY <column> DESC, ties broken by date
+            const DailyOrderKey key = dailyOrderKey(resultOrderBy());
+            auto better = [key](const auto& a, const auto& b) {
+                const double va = key(a.second), vb = key(b.second);
+                return va != vb ? va > vb : a.first < b.first;
+            };
+            if (resultLimit()) {
+                finalStats = parallelTopK(finalStats, resultLimit(), better);
+            } else {
+                parallelSort(finalStats, better);
             }
         }
 
         // Output results
         std::cout << std::fixed << std::setprecision(2);
-        for (const auto& [date, stats] : finalStats) {
-            std::cout << date << ": "
+        for (const auto& [dateKey, stats] : finalStats) {
+            std::cout << formatDateKey(static_cast<uint32_t>(dateKey)) << ": "
                      << "count=" << stats.count << ", "
                      << "passenger_sum=" << stats.passenger_sum << ", "
                      << "trip_distance_sum=" << stats.distance_sum << ", "
@@ -146,11 +163,6 @@ void query4(const std::string& filename) {
                      << "tip_sum=" << stats.tip_sum << std::endl;
         }
 
-        // Cleanup
-        UnmapViewOfFile(data);
-        CloseHandle(mapping);
-        CloseHandle(fileHandle);
-
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << std::endl;
     }
@@ -0,0 +1,113 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <omp.h>
+#include "reader.hpp"
+#include "AggregateTable.hpp"
+#include "DimensionTable.hpp"
+#include "Coordinator.hpp"
+
+// Partial aggregate layout of Stats for sharded runs (see writePartial)
+void writePartialValue(std::ostream& out, const Stats& stats) {
+    writePod(out, static_cast<uint64_t>(stats.count));
+    writePod(out, stats.fare_sum);
+    writePod(out, stats.tip_sum);
+    writePod(out, stats.distance_sum);
+    writePod(out, stats.passenger_sum);
+}
+
+void readPartialValue(std::istream& in, Stats& stats) {
+    uint64_t count = 0;
+    readPod(in, count);
+    stats.count = count;
+    readPod(in, stats.fare_sum);
+    readPod(in, stats.tip_sum);
+    readPod(in, stats.distance_sum);
+    readPod(in, stats.passenger_sum);
+}
+
+// Totals per joined attribute code in one input (or shard)
+std::vector<std::pair<uint64_t, Stats>> scanJoinedStats(const std::string& filename, const DimensionTable& dimension,
+                                                        size_t joinColumn, size_t groupAttr, uint32_t unmatchedCode) {
+    // Dictionary codes are dense, so the group-by runs on a dense array
+    const int numThreads = omp_get_max_threads();
+    std::vector<GroupAggregator<Stats>> threadStats(numThreads,
+        GroupAggregator<Stats>(unmatchedCode + 1));
+    Reader::scanFile(filename, [&](const char* chunk_start, const char* chunk_end, int threadId) {
+        // Process records in this chunk
+        const char* curr = chunk_start;
+        auto& localStats = threadStats[threadId];
+
+        while (curr < chunk_end) {
+            const char* lineEnd = std::find(curr, chunk_end, '\n');
+            std::string_view line(curr, lineEnd - curr);
+            try {
+                TripRecord record = Reader::parseLine(std::string(line));
+
+                // Probe the broadcast dimension table inline
+                auto keyField = Reader::extractColumn(curr, lineEnd, joinColumn);
+                int32_t row = dimension.lookup(Reader::parseInt(keyField, -1));
+                uint32_t groupCode = (row == DimensionTable::NOT_FOUND)
+                    ? unmatchedCode : dimension.code(row, groupAttr);
+
+                auto& stats = localStats[groupCode];
+                stats.count++;
+                stats.fare_sum += record.fare;
+                stats.tip_sum += record.tip;
+                stats.distance_sum += record.Trip_distance;
+                stats.passenger_sum += record.passenger_count;
+            } catch (const std::exception& e) {
+                #pragma omp critical
+                {
+                    std::cerr << "Error parsing line: " << e.what() << std::endl;
+                }
+            }
+
+            curr = lineEnd + 1;
+        }
+    });
+
+    return mergeGroups(threadStats);
+}
+
+// Trip counts and sums grouped by an attribute of a joined dimension table
+// (e.g. Borough or Zone from the taxi zone lookup). The dimension table is
+// broadcast: loaded once, then probed read-only by every scan thread.
+void query5(const std::string& filename, const std::string& dimensionFile,
+            size_t joinColumn, const std::string& groupColumn) {
+    try {
+        const DimensionTable dimension = DimensionTable::load(dimensionFile);
+        const size_t groupAttr = dimension.columnIndex(groupColumn);
+
+        // Trips without a matching dimension row are grouped under an extra code
+        const uint32_t unmatchedCode = static_cast<uint32_t>(dimension.cardinality(groupAttr));
+
+        // Dictionary codes are deterministic per dimension file, so shards agree on them
+        auto groups = shardedGroups<Stats>("query5", filename, [&](const std::string& input) {
+            return scanJoinedStats(input, dimension, joinColumn, groupAttr, unmatchedCode);
+        });
+        if (!groups) return;  // shard worker: partial aggregate written for the coordinator
+        auto& finalStats = *groups;
+
+        // Output results ordered by attribute value
+        auto groupName = [&](uint64_t code) -> std::string {
+            return code == unmatchedCode ? "(unmatched)" : dimension.value(groupAttr, static_cast<uint32_t>(code));
+        };
+        std::sort(finalStats.begin(), finalStats.end(),
+            [&](const auto& a, const auto& b) { return groupName(a.first) < groupName(b.first); });
+
+        std::cout << std::fixed << std::setprecision(2);
+        for (const auto& [code, stats] : finalStats) {
+            std::cout << groupColumn << " " << groupName(code) << ": "
+                     << "count=" << stats.count << ", "
+                     << "passenger_sum=" << stats.passenger_sum << ", "
+                     << "trip_distance_sum=" << stats.distance_sum << ", "
+                     << "fare_sum=" << stats.fare_sum << ", "
+                     << "tip_sum=" << stats.tip_sum << std::endl;
+        }
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <omp.h>
+#include "reader.hpp"
+#include "TopK.hpp"
+
+constexpr size_t DEFAULT_TOP_TRIPS = 100;
+
+// Ranks trips by tip, highest first
+struct HigherTip {
+    bool operator()(const TripRecord& a, const TripRecord& b) const {
+        return a.tip > b.tip;
+    }
+};
+
+// Top-K trips by tip in January 2024 (ORDER BY tip DESC LIMIT k)
+void query6(const std::string& filename) {
+    try {
+        const size_t k = resultLimit() ? resultLimit() : DEFAULT_TOP_TRIPS;
+
+        // Thread-local bounded heaps
+        const int numThreads = omp_get_max_threads();
+        std::vector<TopKHeap<TripRecord, HigherTip>> threadHeaps(numThreads,
+            TopKHeap<TripRecord, HigherTip>(k));
+        Reader::scanFile(filename, [&](const char* chunk_start, const char* chunk_end, int threadId) {
+            // Process records in this chunk
+            const char* curr = chunk_start;
+            auto& heap = threadHeaps[threadId];
+
+            while (curr < chunk_end) {
+                const char* lineEnd = std::find(curr, chunk_end, '\n');
+                // Threshold pruning: rows that cannot beat the current k-th tip
+                // skip full parsing
+                if (heap.full()) {
+                    double tip = Reader::parseDouble(Reader::extractColumn(curr, lineEnd, Reader::TIP_COLUMN));
+                    if (tip <= heap.threshold().tip) {
+                        curr = lineEnd + 1;
+                        continue;
+                    }
+                }
+
+                std::string_view line(curr, lineEnd - curr);
+                try {
+                    TripRecord record = Reader::parseLine(std::string(line));
+                    if (record.isInJanuary2024()) {
+                        heap.push(record);
+                    }
+                } catch (const std::exception& e) {
+                    #pragma omp critical
+                    {
+                        std::cerr << "Error parsing line: " << e.what() << std::endl;
+                    }
+                }
+
+                curr = lineEnd + 1;
+            }
+        });
+
+        // Merge per-thread heaps
+        for (int i = 1; i < numThreads; ++i) {
+            threadHeaps[0].merge(threadHeaps[i]);
+        }
+        auto topTrips = threadHeaps[0].sorted();
+
+        // Output results
+        std::cout << std::fixed << std::setprecision(2);
+        for (size_t rank = 0; rank < topTrips.size(); ++rank) {
+            const auto& trip = topTrips[rank];
+            std::cout << "#" << rank + 1 << " " << trip.getDate() << ": "
+                     << "VendorID=" << trip.VendorID << ", "
+                     << "tip=" << trip.tip << ", "
+                     << "fare=" << trip.fare << ", "
+                     << "trip_distance=" << trip.Trip_distance << std::endl;
+        }
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+#include <omp.h>
+#include "reader.hpp"
+#include "SpillAggregator.hpp"
+
+// Per-window demand statistics
+struct WindowStats {
+    size_t count = 0;
+    int64_t duration_sum = 0;  // seconds, over trips with a valid duration
+    size_t duration_count = 0;
+    double distance_sum = 0.0;
+    double fare_sum = 0.0;
+    double tip_sum = 0.0;
+
+    void merge(const WindowStats& other) {
+        count += other.count;
+        duration_sum += other.duration_sum;
+        duration_count += other.duration_count;
+        distance_sum += other.distance_sum;
+        fare_sum += other.fare_sum;
+        tip_sum += other.tip_sum;
+    }
+
+    void subtract(const WindowStats& other) {
+        count -= other.count;
+        duration_sum -= other.duration_sum;
+        duration_count -= other.duration_count;
+        distance_sum -= other.distance_sum;
+        fare_sum -= other.fare_sum;
+        tip_sum -= other.tip_sum;
+    }
+};
+
+// Trips per pickup time window. With slideMinutes == windowMinutes the windows
+// tumble; otherwise they overlap and a new window starts every slideMinutes.
+// The scan aggregates slide-sized buckets only, and each sliding window is then
+// assembled from windowMinutes / slideMinutes consecutive buckets.
+void query7(const std::string& filename, int64_t windowMinutes, int64_t slideMinutes) {
+    try {
+        if (windowMinutes <= 0 || slideMinutes <= 0 || windowMinutes % slideMinutes != 0) {
+            throw std::runtime_error("Window length must be a positive multiple of the slide");
+        }
+        const int64_t bucketSeconds = slideMinutes * 60;
+        const int64_t bucketsPerWindow = windowMinutes / slideMinutes;
+
+        // Thread-local bucket aggregates keyed by pickup_time / bucketSeconds. A year
+        // of minute buckets is over half a million groups, so each thread spills
+        // beyond its share of the aggregation memory budget.
+        const int numThreads = omp_get_max_threads();
+        std::vector<SpillingAggregator<WindowStats>> threadStats;
+        threadStats.reserve(numThreads);
+        for (int i = 0; i < numThreads; ++i) {
+            threadStats.emplace_back(aggregationMemoryBudget() / numThreads);
+        }
+        Reader::scanFile(filename, [&](const char* chunk_start, const char* chunk_end, int threadId) {
+            // Process records in this chunk
+            const char* curr = chunk_start;
+            auto& localStats = threadStats[threadId];
+
+            while (curr < chunk_end) {
+                const char* lineEnd = std::find(curr, chunk_end, '\n');
+                std::string_view line(curr, lineEnd - curr);
+                curr = lineEnd + 1;
+
+                TripRecord record;
+                try {
+                    record = Reader::parseLine(std::string(line));
+                } catch (const std::exception& e) {
+                    #pragma omp critical
+                    {
+                        std::cerr << "Error parsing line: " << e.what() << std::endl;
+                    }
+                    continue;
+                }
+
+                // Outside the parse try so a failed spill fails the query
+                if (record.pickup_time > 0) {
+                    auto& stats = localStats[static_cast<uint64_t>(record.pickup_time / bucketSeconds)];
+                    stats.count++;
+                    if (record.hasDuration()) {
+                        stats.duration_sum += record.getDurationSeconds();
+                        stats.duration_count++;
+                    }
+                    stats.distance_sum += record.Trip_distance;
+                    stats.fare_sum += record.fare;
+                    stats.tip_sum += record.tip;
+                }
+            }
+        });
+
+        // Partition-by-partition merge of in-memory and spilled buckets
+        std::vector<std::pair<uint64_t, WindowStats>> buckets;
+        mergeSpilledGroups(threadStats, [&](const std::vector<std::pair<uint64_t, WindowStats>>& groups) {
+            #pragma omp critical
+            {
+                buckets.insert(buckets.end(), groups.begin(), groups.end());
+            }
+        });
+        std::sort(buckets.begin(), buckets.end(),
+            [](const auto& a, const auto& b) { return a.first < b.first; });
+
+        // Slide the window one bucket at a time: add the bucket entering it and
+        // subtract the one leaving, so each bucket is touched twice regardless of
+        // bucketsPerWindow. Windows without trips are skipped.
+        if (buckets.empty()) return;
+        std::cout << std::fixed << std::setprecision(2);
+        auto bucketAt = [&](size_t i) { return static_cast<int64_t>(buckets[i].first); };
+        WindowStats window;
+        size_t entering = 0, leaving = 0;
+        const int64_t lastStart = bucketAt(buckets.size() - 1);
+        for (int64_t windowStart = bucketAt(0) - bucketsPerWindow + 1; windowStart <= lastStart; ++windowStart) {
+            while (entering < buckets.size() && bucketAt(entering) < windowStart + bucketsPerWindow) {
+                window.merge(buckets[entering++].second);
+            }
+            while (leaving < entering && bucketAt(leaving) < windowStart) {
+                window.subtract(buckets[leaving++].second);
+            }
+            if (leaving == entering) {
+                // Empty: reset rounding residue and jump to the next window with data
+                window = WindowStats{};
+                windowStart = bucketAt(entering) - bucketsPerWindow;
+                continue;
+            }
+
+            std::cout << formatTimestamp(windowStart * bucketSeconds).substr(0, 16) << ": "
+                     << "count=" << window.count << ", "
+                     << "avg_duration_min=" << (window.duration_count ? window.duration_sum / 60.0 / window.duration_count : 0.0) << ", "
+                     << "trip_distance_sum=" << window.distance_sum << ", "
+                     << "fare_sum=" << window.fare_sum << ", "
+                     << "tip_sum=" << window.tip_sum << std::endl;
+        }
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,42 @@
+#include <iostream>
+#include <iomanip>
+#include "ColumnStore.hpp"
+
+// query3's question (Store_and_fwd_flag = 'Y' trips in January 2024 by VendorID)
+// answered directly on the compressed column file written by "encode": filters
+// run on packed codes and runs, sums on frame-of-reference offsets.
+void query8(const std::string& filename) {
+    try {
+        ColumnStore store = ColumnStore::load(filename, ColumnStore::FLAG_COLUMN | ColumnStore::DATE_COLUMN |
+            ColumnStore::VENDOR_COLUMN | ColumnStore::PASSENGERS_COLUMN | ColumnStore::FARE_COLUMN);
+
+        Selection base = store.selectAll();
+        store.flag.filterEqual('Y', base);
+        store.date.filterRange(20240101, 20240131, base);
+
+        std::cout << std::fixed << std::setprecision(2);
+        for (size_t v = 0; v < store.vendor.dictionary.size(); ++v) {
+            Selection selection = base;
+            store.vendor.codes.filterEqual(static_cast<uint32_t>(v), selection);
+            const size_t count = ColumnStore::countSelected(selection);
+            if (count == 0) continue;
+
+            // Dictionary-encoded sum: value times the count of rows holding each code
+            int64_t passengerSum = 0;
+            for (size_t p = 0; p < store.passengers.dictionary.size(); ++p) {
+                Selection withPassengers = selection;
+                store.passengers.codes.filterEqual(static_cast<uint32_t>(p), withPassengers);
+                passengerSum += static_cast<int64_t>(store.passengers.dictionary[p])
+                              * static_cast<int64_t>(ColumnStore::countSelected(withPassengers));
+            }
+
+            std::cout << "VendorID " << store.vendor.dictionary[v] << ": "
+                     << "count=" << count << ", "
+                     << "passenger_sum=" << passengerSum << ", "
+                     << "fare_sum=" << store.fare.sumSelected(selection) << std::endl;
+        }
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
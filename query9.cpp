@@ -0,0 +1,45 @@
+#include <iostream>
+#include <iomanip>
+#include "ColumnStore.hpp"
+#include "BitmapIndex.hpp"
+
+// query3's question answered from the bitmap index written by "encode":
+// predicates become bitmap AND/OR, counts are container popcounts, and sums
+// read only the matching rows of the column file.
+void query9(const std::string& filename) {
+    try {
+        const BitmapIndex index = BitmapIndex::load(filename + ".idx");
+        const RoaringBitmap matches = RoaringBitmap::intersect(
+            index.flag.find('Y'), index.day.range(20240101, 20240131));
+
+        // Sums need only the passenger and fare columns, and none when nothing matches;
+        // the header is always read to check the index belongs to this store
+        const ColumnStore store = ColumnStore::load(filename, matches.cardinality() > 0
+            ? ColumnStore::PASSENGERS_COLUMN | ColumnStore::FARE_COLUMN : 0);
+        if (store.rowCount != index.rowCount) {
+            throw std::runtime_error("Index " + filename + ".idx was built for a different column file");
+        }
+
+        std::cout << std::fixed << std::setprecision(2);
+        for (size_t v = 0; v < index.vendor.values.size(); ++v) {
+            const RoaringBitmap vendorMatches = RoaringBitmap::intersect(matches, index.vendor.bitmaps[v]);
+            const size_t count = vendorMatches.cardinality();
+            if (count == 0) continue;
+
+            int64_t passengerSum = 0;
+            double fareSum = 0.0;
+            vendorMatches.forEach([&](uint32_t row) {
+                passengerSum += store.passengers.get(row);
+                fareSum += store.fare.get(row);
+            });
+
+            std::cout << "VendorID " << index.vendor.values[v] << ": "
+                     << "count=" << count << ", "
+                     << "passenger_sum=" << passengerSum << ", "
+                     << "fare_sum=" << fareSum << std::endl;
+        }
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
@@ -1,8 +1,17 @@
 #include <windows.h>
+#include <immintrin.h>
 #include <stdexcept>
+#include <exception>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <charconv>
+#include <omp.h>
+#include <new>
+#include <memory>
+#include <mutex>
 #include "reader.hpp"
+#include "CompressedInput.hpp"
 
 // Function to memory-map a file on Windows
 char* mmapFile(const std::string& filename, size_t& fileSize, HANDLE& fileHandle, HANDLE& fileMapping) {
@@ -20,11 +29,13 @@ char* mmapFile(const std::string& filename, size_t& fileSize, HANDLE& fileHandle
         throw std::runtime_error("Error opening file: " + filename);
     }
 
-    fileSize = GetFileSize(fileHandle, nullptr);
-    if (fileSize == INVALID_FILE_SIZE) {
+    // 64-bit size: trip files routinely exceed 4GB
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(fileHandle, &size)) {
         CloseHandle(fileHandle);
         throw std::runtime_error("Error getting file size: " + filename);
     }
+    fileSize = static_cast<size_t>(size.QuadPart);
 
     fileMapping = CreateFileMappingA(
         fileHandle,
@@ -57,61 +68,168 @@ char* mmapFile(const std::string& filename, size_t& fileSize, HANDLE& fileHandle
     return data;
 }
 
-// Function to process a chunk of the file
-void processChunk(const char* start, const char* end, std::vector<TripRecord>& records) {
-    const char* curr = start;
-    while (curr < end) {
-        const char* lineEnd = std::find(curr, end, '\n');
-        if (lineEnd == end) break;
-
-        std::string line(curr, lineEnd - curr);
-        try {
-            records.push_back(Reader::parseLine(line));
-        } catch (const std::exception& e) {
-            std::cerr << "Error parsing line: " << e.what() << std::endl;
+// Constants for SIMD processing
+constexpr size_t SIMD_WIDTH = 32;  // AVX2 processes 256 bits = 32 bytes at a time
+
+size_t countNewlinesSIMD(const char* data, size_t size) {
+    size_t count = 0;
+    const __m256i newline = _mm256_set1_epi8('\n');
+
+    // Process 32 bytes at a time using AVX2
+    const char* end = data + (size - (size % SIMD_WIDTH));
+    for (; data < end; data += SIMD_WIDTH) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+        __m256i cmp = _mm256_cmpeq_epi8(chunk, newline);
+        uint32_t mask = _mm256_movemask_epi8(cmp);
+        count += _mm_popcnt_u32(mask);
+    }
+
+    // Handle remaining bytes
+    for (size_t i = 0; i < size % SIMD_WIDTH; ++i) {
+        if (data[i] == '\n') count++;
+    }
+
+    return count;
+}
+
+RecordBuffer::RecordBuffer(size_t count, bool largePages) : count(count) {
+    if (count == 0) return;
+    size_t bytes = count * sizeof(TripRecord);
+
+    // Large pages need SeLockMemoryPrivilege; fall back to normal pages without it
+    if (largePages) {
+        const size_t largePageSize = GetLargePageMinimum();
+        if (largePageSize > 0) {
+            const size_t rounded = (bytes + largePageSize - 1) / largePageSize * largePageSize;
+            records = static_cast<TripRecord*>(VirtualAlloc(nullptr, rounded,
+                MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE));
         }
+    }
+    if (!records) {
+        records = static_cast<TripRecord*>(VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE));
+    }
+    if (!records) {
+        throw std::runtime_error("Error allocating record buffer");
+    }
+}
+
+RecordBuffer::~RecordBuffer() {
+    release();
+}
+
+RecordBuffer::RecordBuffer(RecordBuffer&& other) noexcept
+    : records(other.records), count(other.count) {
+    other.records = nullptr;
+    other.count = 0;
+}
+
+RecordBuffer& RecordBuffer::operator=(RecordBuffer&& other) noexcept {
+    if (this != &other) {
+        release();
+        records = other.records;
+        count = other.count;
+        other.records = nullptr;
+        other.count = 0;
+    }
+    return *this;
+}
+
+void RecordBuffer::release() {
+    // TripRecord is trivially destructible, so the pages can be released directly
+    if (records) VirtualFree(records, 0, MEM_RELEASE);
+    records = nullptr;
+    count = 0;
+}
+
+// Compressed input cannot be counted without decoding it twice, so each block
+// parses into its own vector and the blocks are copied into place in order
+static RecordBuffer readCompressedFile(const std::string& filename, Compression compression) {
+    std::vector<std::vector<TripRecord>> blocks;
+    std::mutex blocksMutex;
+
+    forEachDecompressedBlock(filename, compression, omp_get_max_threads(),
+        [&](const char* begin, const char* end, int, size_t sequence) {
+            std::vector<TripRecord> parsed;
+            parsed.reserve(countNewlinesSIMD(begin, end - begin) + 1);
+            for (const char* curr = begin; curr < end;) {
+                const char* lineEnd = std::find(curr, end, '\n');
+                parsed.push_back(Reader::parseLine(curr, lineEnd));
+                curr = lineEnd + 1;
+            }
+
+            std::lock_guard<std::mutex> lock(blocksMutex);
+            if (blocks.size() <= sequence) blocks.resize(sequence + 1);
+            blocks[sequence] = std::move(parsed);
+        });
+
+    std::vector<size_t> offsets(blocks.size() + 1, 0);
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        offsets[b + 1] = offsets[b] + blocks[b].size();
+    }
 
-        curr = lineEnd + 1;
+    RecordBuffer records(offsets.back(), useLargePages());
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t b = 0; b < static_cast<int64_t>(blocks.size()); ++b) {
+        std::uninitialized_copy(blocks[b].begin(), blocks[b].end(), records.data() + offsets[b]);
+        std::vector<TripRecord>().swap(blocks[b]);
     }
+    return records;
 }
 
-// Updated function to read and parse file using Windows memory mapping
-std::vector<TripRecord> Reader::readFile(const std::string& filename) {
+RecordBuffer Reader::readFile(const std::string& filename) {
+    const Compression compression = detectCompression(filename);
+    if (compression != Compression::None) {
+        return readCompressedFile(filename, compression);
+    }
+
     size_t fileSize;
     HANDLE fileHandle = nullptr;
     HANDLE fileMapping = nullptr;
     char* data = mmapFile(filename, fileSize, fileHandle, fileMapping);
 
-    const size_t numThreads = omp_get_max_threads();
-    size_t chunkSize = fileSize / numThreads;
-
-    std::vector<std::vector<TripRecord>> threadRecords(numThreads);
+    // Fixed-size chunks starting right after a newline (or at offset 0)
+    const size_t numChunks = std::max<size_t>(1, (fileSize + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    std::vector<size_t> bounds(numChunks + 1, fileSize);
+    bounds[0] = 0;
+    #pragma omp parallel for schedule(static)
+    for (int64_t c = 1; c < static_cast<int64_t>(numChunks); ++c) {
+        const char* nl = std::find(data + c * CHUNK_SIZE, data + fileSize, '\n');
+        bounds[c] = (nl == data + fileSize) ? fileSize : static_cast<size_t>(nl - data) + 1;
+    }
 
-    #pragma omp parallel num_threads(numThreads)
-    {
-        int threadId = omp_get_thread_num();
-        size_t startOffset = threadId * chunkSize;
-        size_t endOffset = (threadId == numThreads - 1) ? fileSize : (threadId + 1) * chunkSize;
-
-        // Ensure chunks start and end at newline boundaries
-        if (startOffset > 0) {
-            while (data[startOffset] != '\n' && startOffset < fileSize) {
-                startOffset++;
-            }
-        }
-        if (endOffset < fileSize) {
-            while (data[endOffset] != '\n' && endOffset < fileSize) {
-                endOffset++;
-            }
+    // Pass 1: count rows per chunk
+    std::vector<size_t> offsets(numChunks + 1, 0);
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t c = 0; c < static_cast<int64_t>(numChunks); ++c) {
+        if (bounds[c + 1] > bounds[c]) {
+            offsets[c + 1] = countNewlinesSIMD(data + bounds[c], bounds[c + 1] - bounds[c]);
         }
+    }
 
-        processChunk(data + startOffset, data + endOffset, threadRecords[threadId]);
+    // A final line without a trailing newline is still a row
+    if (fileSize > 0 && data[fileSize - 1] != '\n') {
+        offsets[numChunks]++;
     }
 
-    // Merge results from all threads
-    std::vector<TripRecord> records;
-    for (const auto& threadRecord : threadRecords) {
-        records.insert(records.end(), threadRecord.begin(), threadRecord.end());
+    // Prefix sum gives each chunk its slice of the output
+    for (size_t c = 0; c < numChunks; ++c) {
+        offsets[c + 1] += offsets[c];
+    }
+
+    RecordBuffer records(offsets[numChunks], useLargePages());
+
+    // Pass 2: parse each chunk straight into its slice
+    #pragma omp parallel for schedule(dynamic)
+    for (int64_t c = 0; c < static_cast<int64_t>(numChunks); ++c) {
+        const char* curr = data + bounds[c];
+        const char* chunkEnd = data + bounds[c + 1];
+        TripRecord* out = records.data() + offsets[c];
+
+        while (curr < chunkEnd) {
+            const char* lineEnd = std::find(curr, chunkEnd, '\n');
+            new (out++) TripRecord(parseLine(curr, lineEnd));
+            curr = lineEnd + 1;
+        }
     }
 
     // Unmap the file and close handles
@@ -122,11 +240,79 @@ std::vector<TripRecord> Reader::readFile(const std::string& filename) {
     return records;
 }
 
+void Reader::scanFile(const std::string& filename,
+                      const std::function<void(const char*, const char*, int)>& processChunk) {
+    const int numThreads = omp_get_max_threads();
+
+    const Compression compression = detectCompression(filename);
+    if (compression != Compression::None) {
+        if (!scanRange().isWholeFile()) {
+            throw std::runtime_error("Byte range scans need uncompressed input: " + filename);
+        }
+        forEachDecompressedBlock(filename, compression, numThreads,
+            [&](const char* begin, const char* end, int worker, size_t) { processChunk(begin, end, worker); });
+        return;
+    }
+
+    size_t fileSize;
+    HANDLE fileHandle = nullptr;
+    HANDLE fileMapping = nullptr;
+    char* data = mmapFile(filename, fileSize, fileHandle, fileMapping);
+    const size_t rangeBegin = static_cast<size_t>(std::min<uint64_t>(scanRange().begin, fileSize));
+    const size_t rangeEnd = static_cast<size_t>(std::clamp<uint64_t>(scanRange().end, rangeBegin, fileSize));
+    const size_t chunkSize = (rangeEnd - rangeBegin) / numThreads;
+
+    // First line starting at or past offset
+    auto lineStart = [&](size_t offset) -> size_t {
+        if (offset == 0 || offset >= fileSize) return offset;
+        const char* nl = std::find(data + offset - 1, data + fileSize, '\n');
+        return nl == data + fileSize ? fileSize : static_cast<size_t>(nl - data) + 1;
+    };
+    auto chunkStart = [&](int t) -> size_t {
+        return lineStart(t == numThreads ? rangeEnd : rangeBegin + t * chunkSize);
+    };
+
+    // An exception must not leave the parallel region; the first one is rethrown
+    std::exception_ptr error;
+    #pragma omp parallel num_threads(numThreads)
+    {
+        const int threadId = omp_get_thread_num();
+        const size_t start = chunkStart(threadId);
+        const size_t end = chunkStart(threadId + 1);
+        if (start < end) {
+            try {
+                processChunk(data + start, data + end, threadId);
+            } catch (...) {
+                #pragma omp critical
+                {
+                    if (!error) error = std::current_exception();
+                }
+            }
+        }
+    }
+
+    // Unmap the file and close handles
+    UnmapViewOfFile(data);
+    CloseHandle(fileMapping);
+    CloseHandle(fileHandle);
+
+    if (error) std::rethrow_exception(error);
+}
+
 std::string_view Reader::extractField(const char* start, const char* end, char delimiter) {
     const char* field_end = std::find(start, end, delimiter);
     return std::string_view(start, field_end - start);
 }
 
+std::string_view Reader::extractColumn(const char* start, const char* end, size_t column) {
+    const char* curr = start;
+    for (size_t i = 0; i < column && curr < end; i++) {
+        curr = std::find(curr, end, ',');
+        if (curr < end) curr++;
+    }
+    return extractField(curr, end);
+}
+
 double Reader::parseDouble(std::string_view sv, double defaultValue) {
     double result = defaultValue;
     std::from_chars(sv.data(), sv.data() + sv.size(), result);
@@ -139,27 +325,80 @@ int32_t Reader::parseInt(std::string_view sv, int32_t defaultValue) {
     return result;
 }
 
+int64_t Reader::parseTimestamp(const char* text) {
+    // Digits sit at fixed offsets: YYYY-MM-DD HH:MM:SS
+    //                              0123456789012345678
+    // Gather all 14 digits into one register (the last two come from a second
+    // load at +3), convert from ASCII, then fold digit pairs with one multiply-add.
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + 3));
+
+    // Validate first: digit positions must hold '0'..'9' and the rest the
+    // separators, else other layouts or garbage would decode to bogus times.
+    // Bit i of each mask is byte i of lo; the hi bits cover bytes 16..18.
+    constexpr int LO_DIGITS = 0xDB6F;   // bytes 0-3, 5-6, 8-9, 11-12, 14-15
+    constexpr int HI_DIGITS = 0xC000;   // bytes 17-18 (hi lanes 14-15)
+    const __m128i loOffset = _mm_sub_epi8(lo, _mm_set1_epi8('0'));
+    const __m128i hiOffset = _mm_sub_epi8(hi, _mm_set1_epi8('0'));
+    const int loDigits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(loOffset, _mm_set1_epi8(9)), loOffset));
+    const int hiDigits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(hiOffset, _mm_set1_epi8(9)), hiOffset));
+    const int loSeparators = _mm_movemask_epi8(_mm_cmpeq_epi8(lo,
+        _mm_setr_epi8(0, 0, 0, 0, '-', 0, 0, '-', 0, 0, ' ', 0, 0, ':', 0, 0)));
+    const int hiSeparators = _mm_movemask_epi8(_mm_cmpeq_epi8(hi,
+        _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, ':', 0, 0)));
+    if (((loDigits & LO_DIGITS) | (loSeparators & ~LO_DIGITS)) != 0xFFFF ||
+        (hiDigits & HI_DIGITS) != HI_DIGITS || !(hiSeparators & 0x2000)) {
+        return 0;
+    }
+
+    __m128i digits = _mm_or_si128(
+        _mm_shuffle_epi8(lo, _mm_setr_epi8(0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, -1, -1, -1, -1)),
+        _mm_shuffle_epi8(hi, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 14, 15, -1, -1)));
+    digits = _mm_subs_epu8(digits, _mm_set1_epi8('0'));
+
+    // 16-bit lanes: century, year-of-century, month, day, hour, minute, second
+    const __m128i pairs = _mm_maddubs_epi16(digits,
+        _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 0, 0));
+    alignas(16) uint16_t v[8];
+    _mm_store_si128(reinterpret_cast<__m128i*>(v), pairs);
+
+    if (v[2] < 1 || v[2] > 12 || v[3] < 1 || v[3] > 31 || v[4] > 23 || v[5] > 59 || v[6] > 59) {
+        return 0;
+    }
+
+    const int64_t days = daysFromCivil(v[0] * 100 + v[1], v[2], v[3]);
+    return days * 86400 + v[4] * 3600 + v[5] * 60 + v[6];
+}
+
+// Start of the next field, clamped to the line end so short lines never read past it
+static inline const char* nextField(const char* curr, const char* end) {
+    const char* comma = std::find(curr, end, ',');
+    return comma == end ? end : comma + 1;
+}
+
 TripRecord Reader::parseLine(const std::string& line) {
+    return parseLine(line.data(), line.data() + line.size());
+}
+
+TripRecord Reader::parseLine(const char* start, const char* end) {
     TripRecord record;
     try {
-        const char* start = line.c_str();
-        const char* end = start + line.length();
         const char* curr = start;
 
         // Extract VendorID
         auto vendorField = extractField(curr, end);
         record.VendorID = parseInt(vendorField);
-        curr += vendorField.length() + 1;
+        curr = nextField(curr, end);
 
         // Skip unused fields with fast pointer arithmetic
         for (int i = 0; i < 5; i++) {
-            curr = std::find(curr, end, ',') + 1;
+            curr = nextField(curr, end);
         }
 
         // Extract passenger_count
         auto passengerField = extractField(curr, end);
         record.passenger_count = parseInt(passengerField);
-        curr = std::find(curr, end, ',') + 1;
+        curr = nextField(curr, end);
 
         // Extract trip_distance
         auto distanceField = extractField(curr, end);
@@ -167,43 +406,54 @@ TripRecord Reader::parseLine(const std::string& line) {
         
         // Skip more unused fields
         for (int i = 0; i < 3; i++) {
-            curr = std::find(curr, end, ',') + 1;
+            curr = nextField(curr, end);
         }
 
-        // Extract date (fixed format YYYY-MM-DD)
-        std::strncpy(record.date, curr, 10);
-        curr = std::find(curr, end, ',') + 1;
+        // Extract date (fixed format YYYY-MM-DD) and full pickup timestamp
+        const char* fieldEnd = std::find(curr, end, ',');
+        std::memcpy(record.date, curr, std::min<size_t>(fieldEnd - curr, 10));
+        if (fieldEnd - curr >= static_cast<ptrdiff_t>(TIMESTAMP_LENGTH)) {
+            record.pickup_time = parseTimestamp(curr);
+        }
+        curr = nextField(curr, end);
+
+        // Dropoff timestamp follows the pickup column
+        fieldEnd = std::find(curr, end, ',');
+        if (fieldEnd - curr >= static_cast<ptrdiff_t>(TIMESTAMP_LENGTH)) {
+            record.dropoff_time = parseTimestamp(curr);
+        }
 
         // Skip more fields to get to payment_type
         for (int i = 0; i < 5; i++) {
-            curr = std::find(curr, end, ',') + 1;
+            curr = nextField(curr, end);
         }
 
         // Extract payment_type
         auto paymentField = extractField(curr, end);
         record.Payment_type = parseInt(paymentField);
-        curr = std::find(curr, end, ',') + 1;
+        curr = nextField(curr, end);
 
         // Extract fare_amount
         auto fareField = extractField(curr, end);
         record.fare = parseDouble(fareField);
-        curr = std::find(curr, end, ',') + 1;
+        curr = nextField(curr, end);
 
         // Skip to tip
-        curr = std::find(curr, end, ',') + 1;
+        curr = nextField(curr, end);
 
         // Extract tip
         auto tipField = extractField(curr, end);
         record.tip = parseDouble(tipField);
+        curr = nextField(curr, end);
 
-        // Extract store_and_fwd_flag if present
+        // Extract store_and_fwd_flag if present (the column after tip)
         auto flagField = extractField(curr, end);
         if (!flagField.empty()) {
             record.Store_and_fwd_flag = flagField[0];
         }
 
     } catch (const std::exception& e) {
-        std::cerr << "Malformed line: " << line.substr(0, 100) << "...\n";
+        std::cerr << "Malformed line: " << std::string_view(start, std::min<size_t>(end - start, 100)) << "...\n";
     }
     return record;
 }
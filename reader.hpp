@@ -3,17 +3,96 @@
 
 #include <string>
 #include <string_view>
+#include <vector>
+#include <functional>
 #include "TripRecord.hpp"
 
+// Allocate loaded records on large pages when the OS grants it (off by default)
+inline bool& useLargePages() {
+    static bool enabled = false;
+    return enabled;
+}
+
+// Byte range of the input covered by scans; a line belongs to the range holding
+// its first byte. Shard workers narrow it, the default covers the whole file.
+struct ByteRange {
+    uint64_t begin = 0;
+    uint64_t end = UINT64_MAX;
+
+    bool isWholeFile() const { return begin == 0 && end == UINT64_MAX; }
+};
+
+inline ByteRange& scanRange() {
+    static ByteRange range;
+    return range;
+}
+
+// SIMD-optimized newline counter using AVX2
+size_t countNewlinesSIMD(const char* data, size_t size);
+
+// Fixed-size, page-aligned array of records allocated once by the loader
+class RecordBuffer {
+public:
+    RecordBuffer() = default;
+    explicit RecordBuffer(size_t count, bool largePages = false);
+    ~RecordBuffer();
+
+    RecordBuffer(const RecordBuffer&) = delete;
+    RecordBuffer& operator=(const RecordBuffer&) = delete;
+    RecordBuffer(RecordBuffer&& other) noexcept;
+    RecordBuffer& operator=(RecordBuffer&& other) noexcept;
+
+    TripRecord* data() { return records; }
+    const TripRecord* data() const { return records; }
+    size_t size() const { return count; }
+
+    TripRecord& operator[](size_t i) { return records[i]; }
+    const TripRecord& operator[](size_t i) const { return records[i]; }
+    TripRecord* begin() { return records; }
+    TripRecord* end() { return records + count; }
+    const TripRecord* begin() const { return records; }
+    const TripRecord* end() const { return records + count; }
+
+private:
+    void release();
+
+    TripRecord* records = nullptr;
+    size_t count = 0;
+};
+
 class Reader {
 public:
     static TripRecord parseLine(const std::string& line);
+    static TripRecord parseLine(const char* start, const char* end);
+
+    // Two passes over the memory-mapped file: count rows per chunk, then parse
+    // every chunk directly into its slice of one pre-sized buffer
+    static RecordBuffer readFile(const std::string& filename);
+
+    // Calls processChunk(begin, end, threadId) on line-aligned pieces of the file
+    // from omp_get_max_threads() threads, restricted to scanRange(). gzip and zstd
+    // inputs are recognised and decompressed on the fly; they scan whole files only.
+    // An exception from processChunk stops the scan and is rethrown to the caller.
+    static void scanFile(const std::string& filename,
+                         const std::function<void(const char*, const char*, int)>& processChunk);
     
     // Fast string parsing utilities
     static std::string_view extractField(const char* start, const char* end, char delimiter = ',');
+    static std::string_view extractColumn(const char* start, const char* end, size_t column);
     static double parseDouble(std::string_view sv, double defaultValue = 0.0);
     static int32_t parseInt(std::string_view sv, int32_t defaultValue = 0);
+
+    // Decodes a fixed-format "YYYY-MM-DD HH:MM:SS" (at least 19 readable bytes) to epoch
+    // seconds; returns 0 (no timestamp) if the text is not in that format
+    static int64_t parseTimestamp(const char* text);
+    static constexpr size_t TIMESTAMP_LENGTH = 19;
     
+    // Column positions read by parseLine, for scans that inspect a field before full parsing
+    static constexpr size_t DATE_COLUMN = 10;
+    static constexpr size_t DROPOFF_COLUMN = 11;
+    static constexpr size_t FARE_COLUMN = 17;
+    static constexpr size_t TIP_COLUMN = 19;
+
     // Buffer management for parallel processing
     static constexpr size_t BUFFER_SIZE = 1024 * 1024; // 1MB
     static constexpr size_t CHUNK_SIZE = 4 * 1024 * 1024; // 4MB chunks for parallel processing